@@ -25,6 +25,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#pragma once
+
 enum {
 	BI_NOT_DEFINED,
 	GSM_850,
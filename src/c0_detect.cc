@@ -30,9 +30,11 @@
 #include <string.h>
 #include <unistd.h>
 
-#include "lime_source.h"
+#include "radio_source.h"
 #include "circular_buffer.h"
 #include "fcch_detector.h"
+#include "channelizer.h"
+#include "worker_pool.h"
 #include "arfcn_freq.h"
 #include "util.h"
 
@@ -43,72 +45,814 @@ extern int g_verbosity;
 
 static const float ERROR_DETECT_OFFSET_MAX = 40e3;
 
-static double vectornorm2(const complex *v, const unsigned int len) {
+/*
+ * Wideband captures are split into 65 channels of 200 kHz (13 MHz).  Only the
+ * channels within +/- 4.8 MHz of the LO are used, the rest are too close to
+ * the edge of the RX filter.
+ */
+static const double		CHAN_SPACING	= 200e3;
+static const unsigned int	WB_CHANNELS	= 65;
+static const unsigned int	WB_DECIMATION	= 48;	// 13 MHz / 48 = GSM_RATE
+static const int		WB_USABLE	= 24;
+static const unsigned int	WB_WORKERS_MAX	= 16;
+
+// memory for pass 1 captures kept for pass 2
+static const size_t		ARENA_BYTES	= 32 << 20;
+
+/*
+ * Power in a channelized stream.  The channel at the LO also carries the DC
+ * offset of the receiver, so remove the mean there.
+ */
+static double channel_power(const complex *y, const unsigned int len, int remove_dc) {
 
 	unsigned int i;
+	complex mean = 0.0;
 	double e = 0.0;
 
+	if(remove_dc) {
+		for(i = 0; i < len; i++)
+			mean += y[i];
+		mean /= (float)len;
+	}
 	for(i = 0; i < len; i++)
-		e += norm(v[i]);
+		e += norm(y[i] - mean);
 
-	return e;
+	return sqrt(e);
 }
 
 
-int c0_detect(lime_source *u, int bi) {
+/*
+ * Fill power[] for every channel in the band from wideband captures, one tune
+ * per 49 channels.  The narrowband sample rate is restored before returning.
+ */
+static int wideband_power(radio_source *u, int bi, double *power) {
 
 	static const double GSM_RATE = 1625000.0 / 6.0;
-	static const unsigned int NOTFOUND_MAX = 20;
 
-	int i, chan_count, j;
-	unsigned int overruns, b_len, frames_len, found_count, notfound_count, r;
-	float offset, spower[BUFSIZ];
-	double freq, sps, n, power[BUFSIZ], sum = 0, a;
-	complex *b;
-	circular_buffer *ub;
-	fcch_detector *l = new fcch_detector(u->sample_rate());
+	int i, c, k, b_bi, count = 0, ret = 0;
+	unsigned int overruns, frames_len, y_len;
+	double narrow_rate, rate, fc, freq;
+	char measured[BUFSIZ];
+	complex *b, *y;
+	channelizer *ch;
 
-	if(bi == BI_NOT_DEFINED) {
-		fprintf(stderr, "error: c0_detect: band not defined\n");
+	narrow_rate = u->sample_rate();
+	if(u->set_sample_rate(WB_CHANNELS * CHAN_SPACING))
+		return -1;
+	rate = u->sample_rate();
+	if(fabs(rate - WB_CHANNELS * CHAN_SPACING) > CHAN_SPACING / 1000) {
+		fprintf(stderr, "error: wideband sample rate not available\n");
+		u->set_sample_rate(narrow_rate);
 		return -1;
 	}
 
-	sps = u->sample_rate() / GSM_RATE;
-	frames_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * sps);
-	ub = u->get_buffer();
+	frames_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * rate / GSM_RATE);
+	ch = new channelizer(WB_CHANNELS, WB_CHANNELS);
+	y_len = ch->output_len(frames_len);
+	y = new complex[WB_CHANNELS * y_len];
+	memset(measured, 0, sizeof(measured));
 
-	// first, we calculate the power in each channel
-	if(g_verbosity > 0) {
-		fprintf(stderr, "calculate power in each channel:\n");
-	}
 	u->start();
-	u->flush();
-	j = 0;
 	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
-		printf(STDOUTCLEAN "%3d of %3d, Pass 1 of 2, %2.2f%%\r", j, amount_chan(bi), (float) 100*j/amount_chan(bi));
+		if(measured[i])
+			continue;
+
+		printf(STDOUTCLEAN "%3d of %3d, Pass 1 of 2, %2.2f%%\r", count, amount_chan(bi), (float) 100*count/amount_chan(bi));
 		fflush(stdout);
-		freq = arfcn_to_freq(i, &bi);
-		if(u->tune(freq) == -1) {
+
+		// put this channel at the low edge of the span
+		b_bi = bi;
+		fc = arfcn_to_freq(i, &b_bi) + WB_USABLE * CHAN_SPACING;
+		if(u->tune(fc) == -1) {
 			fprintf(stderr, "error: radio_source::tune\n");
-			return -1;
+			ret = -1;
+			break;
 		}
 
 		do {
-			u->flush();
 			if(u->fill(frames_len, &overruns)) {
 				fprintf(stderr, "error: radio_source::fill\n");
-				return -1;
+				ret = -1;
+				break;
 			}
+
+			// the capture has a gap, take another
+			if(overruns)
+				u->flush();
 		} while(overruns);
+		if(ret)
+			break;
+
+		b = (complex *)u->get_buffer()->peek(0);
+		ch->channelize(b, frames_len, y, y_len);
+
+		for(c = first_chan(bi); c >= 0; c = next_chan(c, bi)) {
+			b_bi = bi;
+			freq = arfcn_to_freq(c, &b_bi);
+			k = (int)lround((freq - fc) / CHAN_SPACING);
+			if(measured[c] || (abs(k) > WB_USABLE))
+				continue;
+
+			power[c] = channel_power(y + ((k + WB_CHANNELS) % WB_CHANNELS) * y_len, y_len, k == 0);
+			measured[c] = 1;
+			count++;
+			if(g_verbosity > 0) {
+				fprintf(stderr, "\tchan %d (%.1fMHz):\tpower: %lf\n",
+				   c, freq / 1e6, power[c]);
+			}
+		}
+	}
+	u->stop();
+
+	delete[] y;
+	delete ch;
+
+	if(u->set_sample_rate(narrow_rate))
+		return -1;
+
+	return ret;
+}
+
+
+struct fcch_jobs {
+	fcch_detector	**l;
+	complex		*y;
+	unsigned int	y_len;
+	int		*chan,
+			*bin,
+			*found;
+	float		*offset;
+	fcch_evidence	*e;
+};
+
+
+static void fcch_job(void *ctx, unsigned int worker, unsigned int job) {
+
+	static const double GSM_RATE = 1625000.0 / 6.0;
+
+	fcch_jobs *j = (fcch_jobs *)ctx;
+	float offset;
+
+	if(j->l[worker]->scan(j->y + j->bin[job] * j->y_len, j->y_len, &offset, 0) &&
+	   (fabsf(offset - GSM_RATE / 4) < ERROR_DETECT_OFFSET_MAX)) {
+		j->found[job] = 1;
+		j->offset[job] = offset - GSM_RATE / 4;
+	}
+	j->l[worker]->get_evidence(j->e + job);
+}
+
+
+/*
+ * Pass 2 doesn't spend the same number of captures on every channel.  Each
+ * channel is a sequential probability ratio test of "a BTS just strong enough
+ * to be worth finding" (about 0 dB SNR, whose FCCH turns up in 1 capture in
+ * 15) against "noise".  A capture without a burst is scored by how close the
+ * detector came to one and adds the log likelihood ratio of that score to the
+ * channel's total.  Once the total falls below log(miss_target) the channel
+ * is given up on as empty, so a quiet channel costs a couple of captures
+ * while one that keeps showing long low error runs goes on to notfound_max.
+ *
+ * The ratios were measured on synth_source captures of a carrier at 0 dB and
+ * of noise alone.
+ */
+static const float	EVIDENCE_QUIET		= 0.2;	// below this looks empty
+static const float	EVIDENCE_DOUBTFUL	= 0.3;
+static const double	LLR_QUIET		= -2.57;	// log(0.076 / 0.99)
+static const double	LLR_DOUBTFUL		= 3.16;		// log(0.235 / 0.01)
+static const double	LLR_CLOSE		= 6.43;		// log(0.62 / 0.001)
+
+enum {
+	DECIDED_FOUND	= 0,
+	DECIDED_EMPTY	= 1,
+	DECIDED_LIMIT	= 2,
+	DECIDED_MAX	= 3
+};
+
+struct fcch_policy {
+	unsigned int	notfound_max,
+			decided[DECIDED_MAX],
+			captures[DECIDED_MAX],
+			most[DECIDED_MAX],
+			misses[BUFSIZ];
+	double		bound,
+			llr[BUFSIZ];
+};
+
+
+static void policy_init(fcch_policy *p, unsigned int notfound_max, float miss_target) {
+
+	memset(p, 0, sizeof(*p));
+	p->notfound_max = notfound_max;
+	p->bound = log(miss_target);
+}
+
+
+static void policy_decide(fcch_policy *p, int how, unsigned int captures) {
+
+	p->decided[how]++;
+	p->captures[how] += captures;
+	if(captures > p->most[how])
+		p->most[how] = captures;
+}
+
+
+static void policy_found(fcch_policy *p, int chan) {
+
+	policy_decide(p, DECIDED_FOUND, p->misses[chan] + 1);
+}
+
+
+/*
+ * Count a capture of chan without a burst.  Returns 1 if that decides the
+ * channel is empty, or that it has had notfound_max captures.
+ */
+static int policy_miss(fcch_policy *p, int chan, const fcch_evidence *e) {
+
+	float v = (e->run > e->score)? e->run : e->score;
+
+	if(v < EVIDENCE_QUIET)
+		p->llr[chan] += LLR_QUIET;
+	else if(v < EVIDENCE_DOUBTFUL)
+		p->llr[chan] += LLR_DOUBTFUL;
+	else
+		p->llr[chan] += LLR_CLOSE;
+
+	p->misses[chan]++;
+	if(p->llr[chan] <= p->bound) {
+		policy_decide(p, DECIDED_EMPTY, p->misses[chan]);
+		return 1;
+	}
+	if(p->misses[chan] >= p->notfound_max) {
+		policy_decide(p, DECIDED_LIMIT, p->misses[chan]);
+		return 1;
+	}
+	return 0;
+}
+
+
+/*
+ * Give up on chan without a decision, e.g. at the end of a wideband span.
+ */
+static void policy_abandon(fcch_policy *p, int chan) {
+
+	policy_decide(p, DECIDED_LIMIT, p->misses[chan]);
+}
+
+
+static void policy_report(const fcch_policy *p) {
+
+	static const char *name[DECIDED_MAX] = {"found", "empty", "at limit"};
+
+	unsigned int k;
+
+	printf("captures per channel:");
+	for(k = 0; k < DECIDED_MAX; k++) {
+		printf("%s %u %s (avg %.1f, max %u)", k? "," : "",
+		   p->decided[k], name[k], p->decided[k]?
+		   (double)p->captures[k] / p->decided[k] : 0.0, p->most[k]);
+	}
+	printf("\n");
+}
+
+
+/*
+ * Look for FCCH bursts on every channel with more than the threshold power.
+ * Each wideband capture is channelized down to 1 sps and all of the
+ * candidate channels it covers are scanned at once on a pool of workers, one
+ * fcch_detector per worker.  A span is recaptured while some of its
+ * candidates are undecided, up to notfound_max times.
+ */
+static int wideband_fcch(radio_source *u, int bi, const double *power,
+   double threshold, fcch_policy *p) {
+
+	static const double GSM_RATE = 1625000.0 / 6.0;
+
+	int i, c, k, b_bi, count = 0, ret = 0;
+	unsigned int overruns, frames_len, y_len, n, w, n_workers, attempt;
+	double narrow_rate, rate, fc, freq;
+	char done[BUFSIZ];
+	int chan[WB_CHANNELS], bin[WB_CHANNELS], found[WB_CHANNELS];
+	float offset[WB_CHANNELS];
+	fcch_evidence evidence[WB_CHANNELS];
+	complex *b, *y;
+	channelizer *ch;
+	fcch_jobs jobs;
+	worker_pool *pool;
+
+	narrow_rate = u->sample_rate();
+	if(u->set_sample_rate(WB_CHANNELS * CHAN_SPACING))
+		return -1;
+	rate = u->sample_rate();
+	if(fabs(rate - WB_CHANNELS * CHAN_SPACING) > CHAN_SPACING / 1000) {
+		fprintf(stderr, "error: wideband sample rate not available\n");
+		u->set_sample_rate(narrow_rate);
+		return -1;
+	}
+
+	frames_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * rate / GSM_RATE);
+	ch = new channelizer(WB_CHANNELS, WB_DECIMATION);
+	y_len = ch->output_len(frames_len);
+	y = new complex[WB_CHANNELS * y_len];
+	memset(done, 0, sizeof(done));
+
+	// one detector per worker, since each keeps its own filter state
+	n_workers = worker_pool::cpu_count();
+	if(n_workers > WB_WORKERS_MAX)
+		n_workers = WB_WORKERS_MAX;
+	jobs.l = new fcch_detector *[n_workers];
+	for(w = 0; w < n_workers; w++)
+		jobs.l[w] = new fcch_detector(rate / WB_DECIMATION);
+	jobs.y = y;
+	jobs.y_len = y_len;
+	jobs.chan = chan;
+	jobs.bin = bin;
+	jobs.found = found;
+	jobs.offset = offset;
+	jobs.e = evidence;
+	pool = new worker_pool(n_workers, fcch_job, &jobs);
+
+	u->start();
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+		if(done[i] || (power[i] <= threshold))
+			continue;
+
+		// put this channel at the low edge of the span
+		b_bi = bi;
+		fc = arfcn_to_freq(i, &b_bi) + WB_USABLE * CHAN_SPACING;
+		if(u->tune(fc) == -1) {
+			fprintf(stderr, "error: radio_source::tune\n");
+			ret = -1;
+			break;
+		}
+
+		for(attempt = 0; attempt < p->notfound_max; attempt++) {
+			printf(STDOUTCLEAN "%3d of %3d, Pass 2 of 2, %2.2f%%\r", count, amount_chan(bi), (float) 100*count/amount_chan(bi));
+			fflush(stdout);
+
+			// the candidates in this span that are still undecided
+			n = 0;
+			for(c = first_chan(bi); c >= 0; c = next_chan(c, bi)) {
+				b_bi = bi;
+				freq = arfcn_to_freq(c, &b_bi);
+				k = (int)lround((freq - fc) / CHAN_SPACING);
+				if(done[c] || (power[c] <= threshold) || (abs(k) > WB_USABLE))
+					continue;
+				chan[n] = c;
+				bin[n] = (k + WB_CHANNELS) % WB_CHANNELS;
+				found[n] = 0;
+				n++;
+			}
+			if(!n)
+				break;
+
+			// tune() emptied the buffer for the first attempt
+			if(attempt)
+				u->flush();
+			do {
+				if(u->fill(frames_len, &overruns)) {
+					fprintf(stderr, "error: radio_source::fill\n");
+					ret = -1;
+					break;
+				}
+
+				// the capture has a gap, take another
+				if(overruns)
+					u->flush();
+			} while(overruns);
+			if(ret)
+				break;
+
+			b = (complex *)u->get_buffer()->peek(0);
+			ch->channelize(b, frames_len, y, y_len);
+			pool->run(n);
+
+			for(k = 0; k < (int)n; k++) {
+				if(!found[k]) {
+					if(policy_miss(p, chan[k], evidence + k)) {
+						done[chan[k]] = 1;
+						count++;
+					}
+					continue;
+				}
+				policy_found(p, chan[k]);
+				b_bi = bi;
+				freq = arfcn_to_freq(chan[k], &b_bi);
+				printf(STDOUTCLEAN "\tchan: %d (%.1fMHz ", chan[k], freq / 1e6);
+				display_freq(offset[k]);
+				printf(")\tpower: %6.2lf\n", power[chan[k]]);
+				fflush(stdout);
+				done[chan[k]] = 1;
+				count++;
+			}
+		}
+		if(ret)
+			break;
+
+		// whatever is left in the span was not found
+		for(k = 0; k < (int)n; k++) {
+			if(!done[chan[k]]) {
+				policy_abandon(p, chan[k]);
+				done[chan[k]] = 1;
+				count++;
+			}
+		}
+	}
+	u->stop();
+
+	delete pool;
+	for(w = 0; w < n_workers; w++)
+		delete jobs.l[w];
+	delete[] jobs.l;
+	delete[] y;
+	delete ch;
+
+	if(u->set_sample_rate(narrow_rate))
+		return -1;
+
+	return ret;
+}
+
+
+/*
+ * The pass 1 captures of the loudest channels, kept so that pass 2 can look
+ * for FCCH in them before retuning.  Each of the n slots holds len samples.
+ */
+struct capture_arena {
+	unsigned int	n,
+			used,
+			len;
+	int		*chan;
+	double		*power;
+	complex		*buf;
+};
+
+
+static void arena_free(capture_arena *a) {
+
+	delete[] a->chan;
+	delete[] a->power;
+	delete[] a->buf;
+}
 
-		b = (complex *)ub->peek(&b_len);
-		n = sqrt(vectornorm2(b, frames_len));
-		power[i] = n;
-		if(g_verbosity > 0) {
-			fprintf(stderr, "\tchan %d (%.1fMHz):\tpower: %lf\n",
-			   i, freq / 1e6, n);
+
+/*
+ * The slot to keep a capture of the given power in, evicting the quietest
+ * capture once the arena is full, or -1 if it is quieter than all of them.
+ */
+static int arena_slot(capture_arena *a, double power) {
+
+	unsigned int i, k;
+
+	if(a->used < a->n)
+		return a->used++;
+	if(!a->n)
+		return -1;
+
+	for(i = 1, k = 0; i < a->n; i++) {
+		if(a->power[i] < a->power[k])
+			k = i;
+	}
+	if(power <= a->power[k])
+		return -1;
+	return k;
+}
+
+
+/*
+ * Scan the saved captures of the channels above the threshold, all at once on
+ * a pool of workers.  Found channels are printed and marked done, the rest
+ * count a capture without a burst.
+ */
+static void arena_fcch(const capture_arena *arena, double rate, int bi,
+   const double *power, double threshold, char *done, fcch_policy *p) {
+
+	int i, b_bi;
+	unsigned int k, n = 0, w, n_workers;
+	int *chan, *slot, *found;
+	float *offset;
+	fcch_evidence *evidence;
+	double freq;
+	fcch_jobs jobs;
+	worker_pool *pool;
+
+	chan = new int[arena->n];
+	slot = new int[arena->n];
+	found = new int[arena->n];
+	offset = new float[arena->n];
+	evidence = new fcch_evidence[arena->n];
+	for(k = 0; k < arena->used; k++) {
+		if(arena->power[k] <= threshold)
+			continue;
+		chan[n] = arena->chan[k];
+		slot[n] = k;
+		found[n] = 0;
+		n++;
+	}
+
+	n_workers = worker_pool::cpu_count();
+	if(n_workers > WB_WORKERS_MAX)
+		n_workers = WB_WORKERS_MAX;
+	jobs.l = new fcch_detector *[n_workers];
+	for(w = 0; w < n_workers; w++)
+		jobs.l[w] = new fcch_detector(rate);
+	jobs.y = arena->buf;
+	jobs.y_len = arena->len;
+	jobs.chan = chan;
+	jobs.bin = slot;
+	jobs.found = found;
+	jobs.offset = offset;
+	jobs.e = evidence;
+	pool = new worker_pool(n_workers, fcch_job, &jobs);
+	pool->run(n);
+
+	// in channel order
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+		for(k = 0; (k < n) && (chan[k] != i); k++)
+			;
+		if(k == n)
+			continue;
+		if(!found[k]) {
+			if(policy_miss(p, i, evidence + k))
+				done[i] = 1;
+			continue;
+		}
+		policy_found(p, i);
+		b_bi = bi;
+		freq = arfcn_to_freq(i, &b_bi);
+		printf(STDOUTCLEAN "\tchan: %d (%.1fMHz ", i, freq / 1e6);
+		display_freq(offset[k]);
+		printf(")\tpower: %6.2lf\n", power[i]);
+		fflush(stdout);
+		done[i] = 1;
+	}
+
+	delete pool;
+	for(w = 0; w < n_workers; w++)
+		delete jobs.l[w];
+	delete[] jobs.l;
+	delete[] chan;
+	delete[] slot;
+	delete[] found;
+	delete[] offset;
+	delete[] evidence;
+}
+
+
+struct scan_jobs {
+	fcch_detector	*l;
+	complex		*s;
+	unsigned int	s_len,
+			found;
+	float		offset;
+	fcch_evidence	e;
+};
+
+
+static void scan_job(void *ctx, unsigned int, unsigned int) {
+
+	scan_jobs *j = (scan_jobs *)ctx;
+
+	j->found = j->l->scan(j->s, j->s_len, &j->offset, 0);
+	j->l->get_evidence(&j->e);
+}
+
+
+/*
+ * Tune to freq and copy a capture of len samples into b.
+ */
+static int capture_chan(radio_source *u, double freq, complex *b, unsigned int len) {
+
+	unsigned int overruns;
+
+	if(u->tune(freq) == -1) {
+		fprintf(stderr, "error: radio_source::tune\n");
+		return -1;
+	}
+
+	do {
+		if(u->fill(len, &overruns)) {
+			fprintf(stderr, "error: radio_source::fill\n");
+			return -1;
+		}
+
+		// the capture has a gap, take another
+		if(overruns)
+			u->flush();
+	} while(overruns);
+	u->get_buffer()->read(b, len);
+
+	return 0;
+}
+
+
+/*
+ * Look for FCCH bursts on every channel with more than the threshold power,
+ * tuning to each in turn.  Each capture is scanned on a worker thread while
+ * the radio is retuned and the next one is taken into the other buffer.  That
+ * next capture is for the lowest undecided channel other than the one being
+ * scanned, so a channel that needs another attempt alternates with its
+ * neighbour rather than holding up the radio until its result is known.
+ * Once it is the only undecided channel left, it is captured again after its
+ * result is in.  A channel is captured until p decides it.  The pass 1
+ * captures in arena, if any, are tried first and count as a capture.
+ */
+static int narrowband_fcch(radio_source *u, int bi, const double *power,
+   double threshold, fcch_policy *p, const capture_arena *arena) {
+
+	static const double GSM_RATE = 1625000.0 / 6.0;
+
+	int i, next, b_bi, scanning = -1, last, cur = 0, count = 0, ret = 0;
+	unsigned int frames_len;
+	char done[BUFSIZ];
+	double freq;
+	float offset;
+	complex *buf[2];
+	scan_jobs job;
+	worker_pool *pool;
+
+	frames_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * u->sample_rate() / GSM_RATE);
+	buf[0] = new complex[frames_len];
+	buf[1] = new complex[frames_len];
+	job.l = new fcch_detector(u->sample_rate());
+	job.s_len = frames_len;
+	pool = new worker_pool(1, scan_job, &job);
+
+	memset(done, 0, sizeof(done));
+	if(arena)
+		arena_fcch(arena, u->sample_rate(), bi, power, threshold, done, p);
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+		if(power[i] <= threshold)
+			done[i] = 1;
+		if(done[i])
+			count++;
+	}
+
+	for(;;) {
+		printf(STDOUTCLEAN "%3d of %3d, Pass 2 of 2, %2.2f%%\r", count, amount_chan(bi), (float) 100*count/amount_chan(bi));
+		fflush(stdout);
+
+		for(next = first_chan(bi); next >= 0; next = next_chan(next, bi)) {
+			if(!done[next] && (next != scanning))
+				break;
+		}
+		if(next >= 0) {
+			b_bi = bi;
+			if(capture_chan(u, arfcn_to_freq(next, &b_bi), buf[cur], frames_len))
+				ret = -1;
+		}
+
+		last = -1;
+		if(scanning >= 0) {
+			pool->wait();
+			i = last = scanning;
+			scanning = -1;
+			offset = job.offset - GSM_RATE / 4;
+			if(job.found && (fabsf(offset) < ERROR_DETECT_OFFSET_MAX)) {
+				b_bi = bi;
+				freq = arfcn_to_freq(i, &b_bi);
+				printf(STDOUTCLEAN "\tchan: %d (%.1fMHz ", i, freq / 1e6);
+				display_freq(offset);
+				printf(")\tpower: %6.2lf\n", power[i]);
+				fflush(stdout);
+				policy_found(p, i);
+				done[i] = 1;
+				count++;
+			} else if(policy_miss(p, i, &job.e)) {
+				done[i] = 1;
+				count++;
+			}
+		}
+
+		// the channel just scanned is the only one left, take it again
+		if(!ret && (next < 0) && (last >= 0) && !done[last]) {
+			next = last;
+			b_bi = bi;
+			if(capture_chan(u, arfcn_to_freq(next, &b_bi), buf[cur], frames_len))
+				ret = -1;
 		}
-		j++;
+		if(ret || (next < 0))
+			break;
+
+		job.s = buf[cur];
+		pool->start(1);
+		scanning = next;
+		cur ^= 1;
+	}
+
+	delete pool;
+	delete job.l;
+	delete[] buf[0];
+	delete[] buf[1];
+
+	return ret;
+}
+
+
+/*
+ * Scan band bi for BTS.  miss_target is how often pass 2 may give up on a
+ * channel that carries a BTS just strong enough to find.
+ */
+int c0_detect(radio_source *u, int bi, int wideband, float miss_target) {
+
+	static const double GSM_RATE = 1625000.0 / 6.0;
+	static const unsigned int NOTFOUND_MAX = 20;
+
+	int i, chan_count, j, k, ret = 0;
+	unsigned int overruns, frames_len;
+	float spower[BUFSIZ];
+	double freq, sps, n, power[BUFSIZ], a;
+	capture_stats st;
+	capture_arena arena, *saved = 0;
+	fcch_policy policy;
+
+	if(bi == BI_NOT_DEFINED) {
+		fprintf(stderr, "error: c0_detect: band not defined\n");
+		return -1;
+	}
+
+	sps = u->sample_rate() / GSM_RATE;
+	frames_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * sps);
+
+	// first, we calculate the power in each channel
+	if(g_verbosity > 0) {
+		fprintf(stderr, "calculate power in each channel:\n");
+	}
+	if(wideband && wideband_power(u, bi, power)) {
+		fprintf(stderr, "warning: wideband scan failed, scanning each channel\n");
+		wideband = 0;
+	}
+	if(!wideband) {
+		arena.len = frames_len;
+		arena.n = ARENA_BYTES / (frames_len * sizeof(complex));
+		if(arena.n > (unsigned int)amount_chan(bi))
+			arena.n = amount_chan(bi);
+		arena.used = 0;
+		arena.chan = new int[arena.n];
+		arena.power = new double[arena.n];
+		arena.buf = new complex[arena.n * frames_len];
+		saved = &arena;
+
+		u->start();
+		j = 0;
+		for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+			printf(STDOUTCLEAN "%3d of %3d, Pass 1 of 2, %2.2f%%\r", j, amount_chan(bi), (float) 100*j/amount_chan(bi));
+			fflush(stdout);
+			freq = arfcn_to_freq(i, &bi);
+			if(u->tune(freq) == -1) {
+				fprintf(stderr, "error: radio_source::tune\n");
+				ret = -1;
+				break;
+			}
+
+			do {
+				if(u->fill(frames_len, &overruns)) {
+					fprintf(stderr, "error: radio_source::fill\n");
+					ret = -1;
+					break;
+				}
+
+				// the capture has a gap, take another
+				if(overruns)
+					u->flush();
+			} while(overruns);
+			if(ret)
+				break;
+
+			/*
+			 * The front end has already summed the power of
+			 * everything received since the tune, which may be a
+			 * little more than frames_len.  If it has nothing (the
+			 * source kept no statistics since the tune), take the
+			 * power from the capture itself.
+			 */
+			u->get_stats(&st);
+			if(st.count)
+				n = sqrt(st.energy * frames_len / st.count);
+			else
+				n = channel_power((complex *)u->get_buffer()->peek(0),
+				   frames_len, 0);
+			power[i] = n;
+
+			// keep the capture if it is among the loudest so far
+			if((k = arena_slot(&arena, n)) >= 0) {
+				arena.chan[k] = i;
+				arena.power[k] = n;
+				memcpy(arena.buf + k * frames_len,
+				   u->get_buffer()->peek(0),
+				   frames_len * sizeof(complex));
+			}
+			if(g_verbosity > 0) {
+				fprintf(stderr, "\tchan %d (%.1fMHz):\tpower: %lf\tpeak: %.3g\n",
+				   i, freq / 1e6, n, st.peak);
+			}
+			j++;
+		}
+	}
+
+	if(ret) {
+		u->stop();
+		arena_free(&arena);
+		return -1;
 	}
 
 	/*
@@ -132,59 +876,23 @@ int c0_detect(lime_source *u, int bi) {
 	}
 
 	// then we look for fcch bursts
-	found_count = 0;
-	notfound_count = 0;
-	sum = 0;
-	i = first_chan(bi);
-	j = 0;
-	do {
-		printf(STDOUTCLEAN "%3d of %3d, Pass 2 of 2, %2.2f%%\r", j, amount_chan(bi), (float) 100*j/amount_chan(bi));
-		fflush(stdout);
-		if(power[i] <= a) {
-			i = next_chan(i, bi);
-			j++;
-			continue;
-		}
-
-		freq = arfcn_to_freq(i, &bi);
-		if(u->tune(freq) == -1) {
-			fprintf(stderr, "error: radio_source::tune\n");
-			return -1;
+	if(wideband) {
+		policy_init(&policy, NOTFOUND_MAX, miss_target);
+		if(!wideband_fcch(u, bi, power, a, &policy)) {
+			policy_report(&policy);
+			return 0;
 		}
-
-		do {
-			u->flush();
-			if(u->fill(frames_len, &overruns)) {
-				fprintf(stderr, "error: radio_source::fill\n");
-				return -1;
-			}
-		} while(overruns);
-
-		b = (complex *)ub->peek(&b_len);
-		r = l->scan(b, b_len, &offset, 0);
-		if(r && (fabsf(offset - GSM_RATE / 4) < ERROR_DETECT_OFFSET_MAX)) {
-			// found
-			printf(STDOUTCLEAN "\tchan: %d (%.1fMHz ", i, freq / 1e6);
-			display_freq(offset - GSM_RATE / 4);
-			printf(")\tpower: %6.2lf\n", power[i]);
-			fflush(stdout);
-			notfound_count = 0;
-			i = next_chan(i, bi);
-			j++;
-		} else {
-			// not found
-			notfound_count += 1;
-			if(notfound_count >= NOTFOUND_MAX) {
-				notfound_count = 0;
-				i = next_chan(i, bi);
-				j++;
-			}
-		}
-
-	} while(i >= 0);
-
+		fprintf(stderr, "warning: wideband scan failed, scanning each channel\n");
+		u->start();
+	}
+	policy_init(&policy, NOTFOUND_MAX, miss_target);
+	ret = narrowband_fcch(u, bi, power, a, &policy, saved);
 	u->stop();
-	delete l;
+	if(!ret)
+		policy_report(&policy);
 
-	return 0;
+	if(saved)
+		arena_free(saved);
+
+	return ret;
 }
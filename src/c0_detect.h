@@ -25,4 +25,4 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-int c0_detect(lime_source *u, int bi);
+int c0_detect(radio_source *u, int bi, int wideband = 0, float miss_target = 0.01);
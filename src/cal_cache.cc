@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * cal_cache
+ *
+ *	Remembers the result of the DAC trim search per board so that the next
+ *	run can start from the last good code and the measured slope.  Entries
+ *	are kept one per line in $XDG_CACHE_HOME/kal/calibration (or
+ *	$HOME/.cache/kal/calibration):
+ *
+ *		<serial> <dac> <slope> <temperature> <timestamp>
+ *
+ *	The slope is in ppm per code, so that it holds at any BTS frequency,
+ *	and the temperature is the chip's when the entry was written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cal_cache.h"
+
+static const char * const cal_cache_dir = "kal";
+static const char * const cal_cache_name = "calibration";
+static const float SLOPE_MAX = 10.0;	// ppm per code, nominal is 0.1
+
+
+/*
+ * Build the cache file name, creating the directories along the way if
+ * create is set.
+ */
+static int cal_cache_path(char *path, size_t path_len, int create) {
+
+	const char *base;
+	int r;
+
+	if((base = getenv("XDG_CACHE_HOME")) && *base) {
+		r = snprintf(path, path_len, "%s", base);
+	} else if((base = getenv("HOME")) && *base) {
+		r = snprintf(path, path_len, "%s/.cache", base);
+	} else
+		return -1;
+	if((r < 0) || ((size_t)r >= path_len))
+		return -1;
+
+	if(create && (mkdir(path, 0755) == -1) && (errno != EEXIST))
+		return -1;
+
+	r = snprintf(path + r, path_len - r, "/%s", cal_cache_dir) + r;
+	if((r < 0) || ((size_t)r >= path_len))
+		return -1;
+
+	if(create && (mkdir(path, 0755) == -1) && (errno != EEXIST))
+		return -1;
+
+	r = snprintf(path + r, path_len - r, "/%s", cal_cache_name) + r;
+	if((r < 0) || ((size_t)r >= path_len))
+		return -1;
+
+	return 0;
+}
+
+
+static int parse_entry(const char *line, char *serial, size_t serial_len, cal_entry *e) {
+
+	char s[BUFSIZ];
+	unsigned int dac;
+	long timestamp;
+
+	if(sscanf(line, "%s %u %f %f %ld", s, &dac, &e->slope, &e->temp,
+	   &timestamp) != 5)
+		return -1;
+	// a damaged line, not a slope the search could start from
+	if(!(fabsf(e->slope) <= SLOPE_MAX))
+		return -1;
+	if(strlen(s) >= serial_len)
+		return -1;
+	strcpy(serial, s);
+	e->dac = (uint16_t)dac;
+	e->timestamp = (time_t)timestamp;
+
+	return 0;
+}
+
+
+/*
+ * Returns 0 and fills e if there is an entry for serial, -1 otherwise.
+ */
+int cal_cache_load(const char *serial, cal_entry *e) {
+
+	FILE *fp;
+	char path[BUFSIZ], line[BUFSIZ], s[BUFSIZ];
+	cal_entry t;
+	int r = -1;
+
+	if(!serial || !*serial)
+		return -1;
+	if(cal_cache_path(path, sizeof(path), 0))
+		return -1;
+	if(!(fp = fopen(path, "r")))
+		return -1;
+
+	while(fgets(line, sizeof(line), fp)) {
+		if(parse_entry(line, s, sizeof(s), &t))
+			continue;
+		if(!strcmp(s, serial)) {
+			*e = t;
+			r = 0;
+		}
+	}
+	fclose(fp);
+
+	return r;
+}
+
+
+/*
+ * Replace (or add) the entry for serial.  The file is rewritten to a
+ * temporary name and renamed so that a concurrent reader never sees a
+ * partial file.
+ */
+int cal_cache_store(const char *serial, const cal_entry *e) {
+
+	FILE *in, *out;
+	char path[BUFSIZ], tmp[BUFSIZ], line[BUFSIZ], s[BUFSIZ];
+	cal_entry t;
+
+	if(!serial || !*serial)
+		return -1;
+	if(cal_cache_path(path, sizeof(path), 1))
+		return -1;
+	if(snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid()) >= (int)sizeof(tmp))
+		return -1;
+	if(!(out = fopen(tmp, "w"))) {
+		perror("fopen");
+		return -1;
+	}
+
+	if((in = fopen(path, "r"))) {
+		while(fgets(line, sizeof(line), in)) {
+			if(parse_entry(line, s, sizeof(s), &t))
+				continue;
+			if(strcmp(s, serial))
+				fputs(line, out);
+		}
+		fclose(in);
+	}
+	fprintf(out, "%s %u %f %f %ld\n", serial, e->dac, e->slope, e->temp,
+	   (long)e->timestamp);
+
+	if(fclose(out) || rename(tmp, path)) {
+		perror("cal_cache_store");
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <stdexcept>
+#include "channelizer.h"
+
+const unsigned int channelizer::BATCH = 64;
+
+
+/*
+ * The prototype filter is a Blackman-windowed sinc, M * P taps long, with its
+ * cutoff at half the channel spacing.
+ */
+channelizer::channelizer(const unsigned int M, const unsigned int D,
+   const unsigned int P) {
+
+	unsigned int i;
+	double t, w, sum = 0.0;
+
+	if(!M || !D || !P)
+		throw std::runtime_error("channelizer: bad parameters");
+
+	m_M = M;
+	m_D = D;
+	m_h_len = M * P;
+
+	m_h = new float[m_h_len];
+	for(i = 0; i < m_h_len; i++) {
+		t = (i - (m_h_len - 1) / 2.0) / M;
+		w = 0.42 - 0.5 * cos(2.0 * M_PI * i / (m_h_len - 1)) +
+		   0.08 * cos(4.0 * M_PI * i / (m_h_len - 1));
+		m_h[i] = w * ((fabs(t) < 1e-9)? 1.0 : sin(M_PI * t) / (M_PI * t));
+		sum += m_h[i];
+	}
+	for(i = 0; i < m_h_len; i++)
+		m_h[i] /= sum;
+
+	m_rot = new complex[M];
+	for(i = 0; i < M; i++)
+		m_rot[i] = std::polar(1.0f, (float)(-2.0 * M_PI * i / M));
+
+	m_fft = fft_alloc(M * BATCH);
+	if(!m_fft)
+		throw std::runtime_error("channelizer: fftwf_malloc failed!");
+}
+
+
+channelizer::~channelizer() {
+
+	fft_free(m_fft);
+	delete[] m_rot;
+	delete[] m_h;
+}
+
+
+/*
+ * Number of outputs per channel that x_len input samples produce.
+ */
+unsigned int channelizer::output_len(const unsigned int x_len) {
+
+	if(x_len < m_h_len)
+		return 0;
+	return (x_len - m_h_len) / m_D + 1;
+}
+
+
+/*
+ * Channelize x.  Channel k is written to y + k * y_len, so y must hold
+ * M * y_len samples.  Returns the number of samples written per channel.
+ *
+ *	y_k[n] = sum_l h[l] x[n - l] e^(-j 2 pi k (n - l) / M)
+ *	       = e^(-j 2 pi k n / M) sum_r u[r] e^(j 2 pi k r / M)
+ *
+ * where u[r] = sum_q h[r + qM] x[n - r - qM] is the folded, windowed input.
+ */
+unsigned int channelizer::channelize(const complex *x, const unsigned int x_len,
+   complex *y, const unsigned int y_len) {
+
+	unsigned int m, b, n, r, l, k, len, batch, rot;
+	complex u, *f;
+	fftwf_plan plan;
+
+	len = output_len(x_len);
+	if(len > y_len)
+		len = y_len;
+
+	for(m = 0; m < len; m += batch) {
+		batch = (len - m < BATCH)? len - m : BATCH;
+		if(!(plan = fft_plan(m_M, batch, FFTW_BACKWARD, FFTW_ESTIMATE)))
+			return 0;
+
+		for(b = 0; b < batch; b++) {
+
+			// n is the newest sample in the window
+			n = (m + b) * m_D + m_h_len - 1;
+
+			f = m_fft + b * m_M;
+			for(r = 0; r < m_M; r++) {
+				u = 0.0;
+				for(l = r; l < m_h_len; l += m_M)
+					u += m_h[l] * x[n - l];
+				f[r] = u;
+			}
+		}
+
+		fft_execute(plan, m_fft);
+
+		for(b = 0; b < batch; b++) {
+			n = (m + b) * m_D + m_h_len - 1;
+			rot = n % m_M;
+			f = m_fft + b * m_M;
+			for(k = 0; k < m_M; k++)
+				y[k * y_len + m + b] = f[k] * m_rot[(k * rot) % m_M];
+		}
+	}
+
+	return len;
+}
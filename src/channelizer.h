@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * channelizer
+ *
+ *	Splits a wideband capture into M equally spaced channels with a
+ *	polyphase (weighted overlap-add) DFT filter bank.  Channel k is
+ *	centered on k * sample_rate / M (k > M / 2 are the negative
+ *	frequencies) and is decimated by D, which need not equal M.
+ */
+
+#include "complex.h"
+#include "fft_plan.h"
+
+class channelizer {
+
+public:
+	channelizer(const unsigned int M, const unsigned int D, const unsigned int P = 12);
+	~channelizer();
+	unsigned int channelize(const complex *x, const unsigned int x_len, complex *y, const unsigned int y_len);
+	unsigned int output_len(const unsigned int x_len);
+	unsigned int channels() { return m_M; };
+	unsigned int decimation() { return m_D; };
+
+private:
+	unsigned int	m_M,
+			m_D,
+			m_h_len;
+	float		*m_h;
+	complex		*m_rot;
+
+	static const unsigned int BATCH;
+
+	complex		*m_fft;
+};
@@ -174,6 +174,10 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 
 circular_buffer::~circular_buffer() {
 
+	// nothing mapped for a view of someone else's memory
+	if(!m_base)
+		return;
+
 	shmdt((char *)m_base + m_pagesize + 2 * m_buf_size);
 	shmdt((char *)m_base + m_pagesize + m_buf_size);
 	shmdt((char *)m_base + m_pagesize);
@@ -295,11 +299,36 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 
 circular_buffer::~circular_buffer() {
 
-	munmap(m_base, 2 * m_pagesize + 2 * m_buf_size);
+	if(m_base)
+		munmap(m_base, 2 * m_pagesize + 2 * m_buf_size);
 }
 #endif /* !D_HOST_OSX */
 
 
+/*
+ * Wrap buf_len items at buf without mapping anything.  Only for subclasses
+ * that manage the positions themselves, m_buf_size isn't meaningful.
+ */
+circular_buffer::circular_buffer(void *buf, const unsigned int buf_len,
+   const unsigned int item_size) {
+
+	if(!buf || !buf_len || !item_size)
+		throw std::runtime_error("circular_buffer: bad view");
+
+	m_base = 0;
+	m_buf = buf;
+	m_buf_len = buf_len;
+	m_buf_size = 0;
+	m_item_size = item_size;
+	m_pagesize = getpagesize();
+	m_r = m_w = 0;
+	m_read = m_written = 0;
+	m_overwrite = 0;
+
+	pthread_mutex_init(&m_mutex, 0);
+}
+
+
 /*
  * The amount to read can only grow unless someone calls read after this is
  * called.  No real good way to tie the two together.
@@ -485,3 +514,192 @@ unsigned int circular_buffer::buf_len() {
 
 	return m_buf_len;
 }
+
+
+spsc_circular_buffer::spsc_circular_buffer(const unsigned int buf_len,
+   const unsigned int item_size) : circular_buffer(buf_len, item_size, 0) {
+
+	if(m_buf_size % m_item_size)
+		throw std::runtime_error("spsc_circular_buffer: item size must divide the page size");
+
+	m_head = 0;
+	m_tail = 0;
+}
+
+
+unsigned int spsc_circular_buffer::data_available() {
+
+	unsigned long long tail = m_tail.load(std::memory_order_relaxed);
+
+	return m_head.load(std::memory_order_acquire) - tail;
+}
+
+
+unsigned int spsc_circular_buffer::space_available() {
+
+	unsigned long long head = m_head.load(std::memory_order_relaxed);
+
+	return m_buf_len - (head - m_tail.load(std::memory_order_acquire));
+}
+
+
+/*
+ * consumer
+ */
+void *spsc_circular_buffer::peek(unsigned int *buf_len) {
+
+	unsigned long long tail = m_tail.load(std::memory_order_relaxed);
+
+	if(buf_len)
+		*buf_len = m_head.load(std::memory_order_acquire) - tail;
+
+	return (char *)m_buf + (tail % m_buf_len) * m_item_size;
+}
+
+
+unsigned int spsc_circular_buffer::purge(const unsigned int buf_len) {
+
+	unsigned long long tail = m_tail.load(std::memory_order_relaxed);
+	unsigned int len;
+
+	len = m_head.load(std::memory_order_acquire) - tail;
+	len = MIN(buf_len, len);
+	m_tail.store(tail + len, std::memory_order_release);
+
+	return len;
+}
+
+
+unsigned int spsc_circular_buffer::read(void *buf, const unsigned int buf_len) {
+
+	unsigned int len;
+	void *p;
+
+	p = peek(&len);
+	len = MIN(buf_len, len);
+	memcpy(buf, p, len * m_item_size);
+
+	return purge(len);
+}
+
+
+/*
+ * Discard everything written so far.  Only the consumer may call this.
+ */
+void spsc_circular_buffer::flush() {
+
+	m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+
+/*
+ * producer
+ */
+void *spsc_circular_buffer::poke(unsigned int *buf_len) {
+
+	unsigned long long head = m_head.load(std::memory_order_relaxed);
+
+	if(buf_len)
+		*buf_len = m_buf_len - (head - m_tail.load(std::memory_order_acquire));
+
+	return (char *)m_buf + (head % m_buf_len) * m_item_size;
+}
+
+
+void spsc_circular_buffer::wrote(unsigned int len) {
+
+	m_head.store(m_head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+}
+
+
+unsigned int spsc_circular_buffer::write(const void *buf, const unsigned int buf_len) {
+
+	unsigned int len;
+	void *p;
+
+	p = poke(&len);
+	len = MIN(buf_len, len);
+	memcpy(p, buf, len * m_item_size);
+	wrote(len);
+
+	return len;
+}
+
+
+mapped_buffer::mapped_buffer(void *buf, const unsigned int buf_len,
+   const unsigned int item_size) : circular_buffer(buf, buf_len, item_size) {
+
+}
+
+
+unsigned int mapped_buffer::read(void *buf, const unsigned int buf_len) {
+
+	unsigned int n = MIN(buf_len, data_available());
+
+	memcpy(buf, (char *)m_buf + m_read * m_item_size, n * m_item_size);
+	m_read += n;
+
+	return n;
+}
+
+
+void *mapped_buffer::peek(unsigned int *buf_len) {
+
+	if(buf_len)
+		*buf_len = data_available();
+
+	return (char *)m_buf + m_read * m_item_size;
+}
+
+
+unsigned int mapped_buffer::purge(const unsigned int buf_len) {
+
+	unsigned int n = MIN(buf_len, data_available());
+
+	m_read += n;
+
+	return n;
+}
+
+
+void *mapped_buffer::poke(unsigned int *buf_len) {
+
+	if(buf_len)
+		*buf_len = space_available();
+
+	return (char *)m_buf + m_written * m_item_size;
+}
+
+
+void mapped_buffer::wrote(unsigned int len) {
+
+	m_written += MIN(len, space_available());
+}
+
+
+/*
+ * Writing to a mapped recording is unsupported: the contents are fixed, and
+ * wrote() only makes more of them readable.  Nothing is written.
+ */
+unsigned int mapped_buffer::write(const void *, const unsigned int) {
+
+	return 0;
+}
+
+
+unsigned int mapped_buffer::data_available() {
+
+	return m_written - m_read;
+}
+
+
+unsigned int mapped_buffer::space_available() {
+
+	return m_buf_len - m_written;
+}
+
+
+void mapped_buffer::flush() {
+
+	m_read = m_written;
+}
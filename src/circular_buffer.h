@@ -45,27 +45,30 @@
  */
 
 #include <pthread.h>
+#include <atomic>
 
 class circular_buffer {
 public:
 	circular_buffer(const unsigned int buf_len, const unsigned int item_size = 1, const unsigned int overwrite = 0);
-	~circular_buffer();
+	virtual ~circular_buffer();
 
-	unsigned int read(void *buf, const unsigned int buf_len);
-	void *peek(unsigned int *buf_len);
-	unsigned int purge(const unsigned int buf_len);
-	void *poke(unsigned int *buf_len);
-	void wrote(unsigned int len);
-	unsigned int write(const void *buf, const unsigned int buf_len);
-	unsigned int data_available();
-	unsigned int space_available();
-	void flush();
+	virtual unsigned int read(void *buf, const unsigned int buf_len);
+	virtual void *peek(unsigned int *buf_len);
+	virtual unsigned int purge(const unsigned int buf_len);
+	virtual void *poke(unsigned int *buf_len);
+	virtual void wrote(unsigned int len);
+	virtual unsigned int write(const void *buf, const unsigned int buf_len);
+	virtual unsigned int data_available();
+	virtual unsigned int space_available();
+	virtual void flush();
 	void flush_nolock();
 	void lock();
 	void unlock();
 	unsigned int buf_len();
 
-private:
+protected:
+	circular_buffer(void *buf, const unsigned int buf_len, const unsigned int item_size);
+
 	void *m_buf;
 	unsigned int m_buf_len, m_buf_size, m_r, m_w, m_item_size;
 	unsigned long long m_read, m_written;
@@ -77,3 +80,60 @@ private:
 
 	pthread_mutex_t	m_mutex;
 };
+
+
+/*
+ * spsc_circular_buffer
+ *
+ * The same mirrored mapping, but for exactly one producer thread (poke, wrote,
+ * write) and one consumer thread (peek, purge, read, flush).  The read and
+ * write counters are atomics that only their owner modifies, so none of the
+ * calls take a lock or enter the kernel.  Overwrite mode isn't supported.
+ *
+ * Unlike circular_buffer, the positions are not reset to the start of the
+ * buffer when it empties.  The mirrored mapping keeps any available run
+ * contiguous regardless.
+ */
+class spsc_circular_buffer : public circular_buffer {
+public:
+	spsc_circular_buffer(const unsigned int buf_len, const unsigned int item_size = 1);
+
+	unsigned int read(void *buf, const unsigned int buf_len);
+	void *peek(unsigned int *buf_len);
+	unsigned int purge(const unsigned int buf_len);
+	void *poke(unsigned int *buf_len);
+	void wrote(unsigned int len);
+	unsigned int write(const void *buf, const unsigned int buf_len);
+	unsigned int data_available();
+	unsigned int space_available();
+	void flush();
+
+private:
+	// keep the producer and consumer counters on separate cache lines
+	alignas(64) std::atomic<unsigned long long> m_head;	// items written
+	alignas(64) std::atomic<unsigned long long> m_tail;	// items read
+};
+
+
+/*
+ * mapped_buffer
+ *
+ * A view of buf_len items that someone else owns, such as a mapped file.  The
+ * items are made readable in order with poke() and wrote() and consumed with
+ * peek(), purge() and read() like any other buffer, but nothing is copied in
+ * and the space is never reused.  Single threaded, no locking.
+ */
+class mapped_buffer : public circular_buffer {
+public:
+	mapped_buffer(void *buf, const unsigned int buf_len, const unsigned int item_size = 1);
+
+	unsigned int read(void *buf, const unsigned int buf_len);
+	void *peek(unsigned int *buf_len);
+	unsigned int purge(const unsigned int buf_len);
+	void *poke(unsigned int *buf_len);
+	void wrote(unsigned int len);
+	unsigned int write(const void *buf, const unsigned int buf_len);
+	unsigned int data_available();
+	unsigned int space_available();
+	void flush();
+};
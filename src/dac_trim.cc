@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * dac_trim
+ *
+ *	Searches for the VCTCXO DAC code that gives the smallest frequency
+ *	offset.  The offset is very nearly a linear function of the DAC code
+ *	(about -0.1 ppm per code), so rather than stepping one code at a time
+ *	we fit a line through every measurement taken so far and jump to its
+ *	zero crossing.  Once the prediction lands on a code that has already
+ *	been measured, the codes around it are checked to pick the best one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "lime_source.h"
+#include "fcch_detector.h"
+#include "offset.h"
+#include "dac_trim.h"
+
+static const unsigned int	MEASURE_MAX	= 16;
+static const unsigned int	SEARCH_MAX	= 6;
+static const int		STEP_MAX	= 32;
+static const int		DAC_MAX		= 0xffff;
+static const double		NOMINAL_PPM	= -0.1;
+static const double		CONFIDENT	= 0.4;
+
+
+struct dac_point {
+	int	dac;
+	float	off;
+};
+
+
+static int measure(lime_source *u, int dac, float tolerance, int estimator, unsigned int workers, dac_point *p, unsigned int *p_len, float *off) {
+
+	fprintf(stderr, "================================================\n");
+	u->tune_dac((uint16_t)dac);
+	if(offset_detect(u, off, tolerance, estimator, workers))
+		return -1;
+
+	p[*p_len].dac = dac;
+	p[*p_len].off = *off;
+	*p_len += 1;
+
+	return 0;
+}
+
+
+static int measured(const dac_point *p, unsigned int p_len, int dac) {
+
+	for(unsigned int i = 0; i < p_len; i++) {
+		if(p[i].dac == dac)
+			return 1;
+	}
+	return 0;
+}
+
+
+static unsigned int best_point(const dac_point *p, unsigned int p_len) {
+
+	unsigned int i, r = 0;
+
+	for(i = 1; i < p_len; i++) {
+		if(fabs(p[i].off) < fabs(p[r].off))
+			r = i;
+	}
+	return r;
+}
+
+
+/*
+ * Least-squares fit of offset against DAC code.  Returns 0 if there are not
+ * enough distinct codes to fit a line.
+ */
+static int fit(const dac_point *p, unsigned int p_len, double *a, double *b) {
+
+	unsigned int i;
+	double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0, d;
+
+	for(i = 0; i < p_len; i++) {
+		sx += p[i].dac;
+		sy += p[i].off;
+		sxx += (double)p[i].dac * p[i].dac;
+		sxy += (double)p[i].dac * p[i].off;
+	}
+	d = p_len * sxx - sx * sx;
+	if((p_len < 2) || (fabs(d) < 1e-9))
+		return 0;
+
+	*b = (p_len * sxy - sx * sy) / d;
+	*a = (sy - *b * sx) / p_len;
+
+	return 1;
+}
+
+
+static int clamp_dac(double dac, int from) {
+
+	int r = (int)lround(dac);
+
+	if(r > from + STEP_MAX)
+		r = from + STEP_MAX;
+	if(r < from - STEP_MAX)
+		r = from - STEP_MAX;
+	if(r < 0)
+		r = 0;
+	if(r > DAC_MAX)
+		r = DAC_MAX;
+	return r;
+}
+
+
+/*
+ * Starting from code dac, find the code that minimizes the offset.  slope is
+ * the expected change in offset (Hz at freq) per DAC code, e.g. scaled from
+ * the calibration cache; pass 0 to use a nominal value for freq.  tolerance,
+ * estimator and workers are handed to offset_detect() for each measurement.
+ * The best code, its offset and the measured slope (Hz at freq) are returned
+ * through the pointers.
+ */
+int dac_trim(lime_source *u, double freq, uint16_t dac, float slope,
+   float tolerance, int estimator, unsigned int workers, uint16_t *dac_best,
+   float *off_best, float *slope_est) {
+
+	dac_point p[MEASURE_MAX];
+	unsigned int p_len = 0, i;
+	int next = dac, best, done;
+	float off;
+	double a, b, nominal;
+
+	nominal = (slope < 0.0)? slope : NOMINAL_PPM * freq / 1e6;
+	b = nominal;
+
+	if(measure(u, next, tolerance, estimator, workers, p, &p_len, &off))
+		return -1;
+
+	// secant / regression steps toward the predicted zero crossing
+	for(i = 0; i < SEARCH_MAX; i++) {
+		// a fit much shallower than expected is noise, not slope
+		if(!fit(p, p_len, &a, &b) || (b > nominal / 4)) {
+			// no usable fit yet, step from the last point
+			b = nominal;
+			a = p[p_len - 1].off - b * p[p_len - 1].dac;
+		}
+		next = clamp_dac(-a / b, p[p_len - 1].dac);
+		fprintf(stderr, "\nPredicted DAC trim %d (%.1f Hz per code)\n",
+		   next, b);
+		if(measured(p, p_len, next) || (p_len >= MEASURE_MAX))
+			break;
+		if(measure(u, next, tolerance, estimator, workers, p, &p_len, &off))
+			return -1;
+	}
+
+	/*
+	 * Confirm with the neighbouring codes, walking while an edge wins.  If
+	 * the best offset is well inside half a code's worth of slope, the
+	 * neighbours cannot beat it and there is nothing to confirm.
+	 */
+	do {
+		i = best_point(p, p_len);
+		best = p[i].dac;
+		if(fabs(p[i].off) < CONFIDENT * fabs(b))
+			break;
+		done = 1;
+		for(next = best - 1; next <= best + 1; next += 2) {
+			if((next < 0) || (next > DAC_MAX) ||
+			   measured(p, p_len, next) || (p_len >= MEASURE_MAX))
+				continue;
+			if(measure(u, next, tolerance, estimator, workers, p, &p_len, &off))
+				return -1;
+			done = 0;
+		}
+	} while(!done);
+	off = p[best_point(p, p_len)].off;
+
+	if(fit(p, p_len, &a, &b) && (b <= nominal / 4))
+		nominal = b;
+
+	if(dac_best)
+		*dac_best = (uint16_t)best;
+	if(off_best)
+		*off_best = off;
+	if(slope_est)
+		*slope_est = nominal;
+
+	return 0;
+}
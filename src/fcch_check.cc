@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * fcch_check
+ *
+ *	Checks fcch_detector against signals whose answer is known: a clean
+ *	tone, and two multiframes from synth_source with its FCCH bursts at a
+ *	known offset.
+ *
+ *	phase	phase_detect() on the clean tone, and every burst the phase
+ *		estimator finds in the capture, against the offset
+ *	bursts	scan_bursts() finds every burst in the capture, 10 or 11
+ *		frames apart, each at the offset
+ *	stream	stream() finds the same bursts as scan_bursts(), whatever the
+ *		chunks the capture is passed in, again after stream_reset(),
+ *		and with scan_bursts() called on other samples in between
+ *
+ *	Exits non-zero on any failure, for make check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fcch_detector.h"
+#include "synth_source.h"
+
+static const double		GSM_RATE	= 1625000.0 / 6.0;
+static const unsigned int	CAPTURE_LEN	= 2 * 51 * 1250;	// 2 multiframes
+static const unsigned int	BURSTS_MAX	= 32;
+static const double		OFFSET		= 1000.0;
+static const char * const	SYNTH_SPEC	= "offset=1000:snr=20:seed=3";
+static const char * const	OTHER_SPEC	= "offset=-20000:snr=10:seed=9";
+static const unsigned int	OTHER_LEN	= 10000;
+
+// a clean tone is fitted to within this (Hz)
+static const double		TONE_TOLERANCE	= 0.05;
+
+// FCCH bursts are 10 frames apart, 11 from frame 40 to the next multiframe
+static const unsigned int	FCCH_GAP	= 10 * 1250;
+static const unsigned int	FCCH_GAP_LONG	= 11 * 1250;
+static const unsigned int	FCCH_LEN	= 148;
+static const unsigned int	POS_TOLERANCE	= 30;
+
+// each burst at 20 dB, and the mean of all of them (Hz)
+static const double		BURST_TOLERANCE	= 50.0;
+static const double		MEAN_TOLERANCE	= 10.0;
+
+// stream() against scan_bursts(), after the stream's threshold has settled
+static const unsigned int	STREAM_WARMUP	= 12 * 1250;
+static const double		STREAM_TOLERANCE = 20.0;
+
+int g_verbosity = 0;
+int g_debug = 0;
+
+
+/*
+ * len samples of a C0 as given by spec.  With SYNTH_SPEC, the FCCH bursts are
+ * OFFSET above GSM_RATE / 4.
+ */
+static int make_capture(complex *s, unsigned int len, const char *spec) {
+
+	synth_source u(GSM_RATE);
+	unsigned int n;
+
+	if(u.open(spec) || u.tune(900e6) || u.read(s, len, &n) || (n != len)) {
+		printf("error: synth_source\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * The offset of every burst found must be near OFFSET, and their mean closer.
+ */
+static int check_offsets(const char *name, const fcch_burst *b, unsigned int n) {
+
+	unsigned int i, bad = 0;
+	double d, sum = 0.0;
+
+	if(!n) {
+		printf("%-8s FAIL: no bursts\n", name);
+		return 1;
+	}
+	for(i = 0; i < n; i++) {
+		d = b[i].offset - GSM_RATE / 4 - OFFSET;
+		sum += d;
+		if((fabs(d) > BURST_TOLERANCE) || !(b[i].variance > 0.0)) {
+			printf("%-8s FAIL: burst at %llu is %.1fHz off, variance %g\n",
+			   name, b[i].pos, d, b[i].variance);
+			bad++;
+		}
+	}
+	if(fabs(sum / n) > MEAN_TOLERANCE) {
+		printf("%-8s FAIL: mean of %u bursts is %.1fHz off\n", name, n, sum / n);
+		bad++;
+	}
+	if(!bad)
+		printf("%-8s ok: %u bursts, mean %.2fHz off\n", name, n, sum / n);
+
+	return bad;
+}
+
+
+static int check_phase(const complex *capture) {
+
+	static const unsigned int TONE_LEN = 148;
+
+	fcch_detector l(GSM_RATE);
+	complex tone[TONE_LEN];
+	fcch_burst b[BURSTS_MAX];
+	unsigned int t, n;
+	double f = GSM_RATE / 4 + 1234.5, w = 2.0 * M_PI * f / GSM_RATE;
+	float est, coherence, var;
+	int bad = 0;
+
+	for(t = 0; t < TONE_LEN; t++)
+		tone[t] = complex(cos(w * t), sin(w * t));
+	est = l.phase_detect(tone, TONE_LEN, &coherence, &var);
+	if((fabs(est - f) > TONE_TOLERANCE) || (coherence < 0.99)) {
+		printf("phase    FAIL: tone at %.2fHz fitted at %.2fHz, coherence %.3f\n",
+		   f, est, coherence);
+		bad++;
+	} else
+		printf("phase    ok: tone fitted to %.3fHz\n", est - f);
+
+	l.set_estimator(FCCH_EST_PHASE);
+	n = l.scan_bursts(capture, CAPTURE_LEN, b, BURSTS_MAX, 0);
+	bad += check_offsets("phase", b, n);
+
+	return bad;
+}
+
+
+/*
+ * Every burst in the capture is found once: they are FCCH_GAP or
+ * FCCH_GAP_LONG apart, and there is no room for another before the first or
+ * after the last.
+ */
+static int check_bursts(const complex *capture) {
+
+	fcch_detector l(GSM_RATE);
+	fcch_burst b[BURSTS_MAX];
+	unsigned int i, n, gap, consumed;
+	int bad = 0;
+
+	n = l.scan_bursts(capture, CAPTURE_LEN, b, BURSTS_MAX, &consumed);
+	if(consumed != CAPTURE_LEN) {
+		printf("bursts   FAIL: consumed %u of %u samples\n", consumed, CAPTURE_LEN);
+		bad++;
+	}
+	if(!n) {
+		printf("bursts   FAIL: no bursts\n");
+		return bad + 1;
+	}
+	if(b[0].pos > FCCH_GAP_LONG + POS_TOLERANCE) {
+		printf("bursts   FAIL: first burst at %llu, one was missed\n", b[0].pos);
+		bad++;
+	}
+	if(b[n - 1].pos + FCCH_GAP_LONG + FCCH_LEN + POS_TOLERANCE < CAPTURE_LEN) {
+		printf("bursts   FAIL: last burst at %llu, one was missed\n", b[n - 1].pos);
+		bad++;
+	}
+	for(i = 1; i < n; i++) {
+		gap = b[i].pos - b[i - 1].pos;
+		if((abs((int)gap - (int)FCCH_GAP) > (int)POS_TOLERANCE) &&
+		   (abs((int)gap - (int)FCCH_GAP_LONG) > (int)POS_TOLERANCE)) {
+			printf("bursts   FAIL: bursts at %llu and %llu are %u apart\n",
+			   b[i - 1].pos, b[i].pos, gap);
+			bad++;
+		}
+	}
+	for(i = 0; i < n; i++) {
+		if(!(b[i].pm > 0.0)) {
+			printf("bursts   FAIL: burst at %llu has score %g\n", b[i].pos, b[i].pm);
+			bad++;
+		}
+	}
+	if(!bad)
+		printf("bursts   ok: %u bursts, from %llu to %llu\n", n, b[0].pos, b[n - 1].pos);
+
+	return bad + check_offsets("bursts", b, n);
+}
+
+
+/*
+ * Pass the capture to stream() chunk samples at a time, calling scan_bursts()
+ * on other between chunks if it is given.
+ */
+static unsigned int stream_chunks(fcch_detector *l, const complex *s, unsigned int chunk, const complex *other, fcch_burst *b) {
+
+	fcch_burst ob[BURSTS_MAX];
+	unsigned int used = 0, n = 0, len, consumed;
+
+	while(used < CAPTURE_LEN) {
+		len = (CAPTURE_LEN - used < chunk)? CAPTURE_LEN - used : chunk;
+		n += l->stream(s + used, len, b + n, BURSTS_MAX - n, &consumed);
+		used += consumed;
+		if(other)
+			l->scan_bursts(other, OTHER_LEN, ob, BURSTS_MAX, 0);
+	}
+
+	return n;
+}
+
+
+/*
+ * The bursts in a and b after STREAM_WARMUP are the same ones.
+ */
+static int same_bursts(const char *what, const fcch_burst *a, unsigned int a_n, const fcch_burst *b, unsigned int b_n) {
+
+	unsigned int i = 0, j = 0, n = 0;
+
+	for(;;) {
+		while((i < a_n) && (a[i].pos < STREAM_WARMUP))
+			i++;
+		while((j < b_n) && (b[j].pos < STREAM_WARMUP))
+			j++;
+		if((i == a_n) || (j == b_n))
+			break;
+		if((abs((int)(a[i].pos - b[j].pos)) > (int)POS_TOLERANCE) ||
+		   (fabs(a[i].offset - b[j].offset) > STREAM_TOLERANCE)) {
+			printf("stream   FAIL: %s: burst at %llu, %.1fHz against %llu, %.1fHz\n",
+			   what, b[j].pos, b[j].offset - GSM_RATE / 4, a[i].pos,
+			   a[i].offset - GSM_RATE / 4);
+			return 1;
+		}
+		i++;
+		j++;
+		n++;
+	}
+	if((i != a_n) || (j != b_n) || !n) {
+		printf("stream   FAIL: %s: %u bursts against %u\n", what, b_n, a_n);
+		return 1;
+	}
+	printf("stream   ok: %s: the same %u bursts\n", what, n);
+
+	return 0;
+}
+
+
+static int check_stream(const complex *capture, const complex *other) {
+
+	static const unsigned int CHUNKS[] = { CAPTURE_LEN, 4093, 1000 };
+
+	fcch_detector *l;
+	fcch_burst ref[BURSTS_MAX], b[BURSTS_MAX];
+	unsigned int ref_n, n, i;
+	char what[64];
+	int bad = 0;
+
+	l = new fcch_detector(GSM_RATE);
+	ref_n = l->scan_bursts(capture, CAPTURE_LEN, ref, BURSTS_MAX, 0);
+	delete l;
+
+	for(i = 0; i < sizeof(CHUNKS) / sizeof(*CHUNKS); i++) {
+		l = new fcch_detector(GSM_RATE);
+		n = stream_chunks(l, capture, CHUNKS[i], 0, b);
+		snprintf(what, sizeof(what), "chunks of %u", CHUNKS[i]);
+		bad += same_bursts(what, ref, ref_n, b, n);
+
+		// positions count from the reset
+		l->stream_reset();
+		n = stream_chunks(l, capture, CHUNKS[i], 0, b);
+		snprintf(what, sizeof(what), "chunks of %u after a reset", CHUNKS[i]);
+		bad += same_bursts(what, ref, ref_n, b, n);
+		delete l;
+	}
+
+	l = new fcch_detector(GSM_RATE);
+	n = stream_chunks(l, capture, 4093, other, b);
+	bad += same_bursts("scan_bursts() in between", ref, ref_n, b, n);
+	delete l;
+
+	return bad;
+}
+
+
+int main() {
+
+	complex *s, *other;
+	int bad = 0;
+
+	s = new complex[CAPTURE_LEN];
+	other = new complex[OTHER_LEN];
+	if(make_capture(s, CAPTURE_LEN, SYNTH_SPEC) ||
+	   make_capture(other, OTHER_LEN, OTHER_SPEC)) {
+		delete[] s;
+		delete[] other;
+		return 1;
+	}
+
+	bad += check_phase(s);
+	bad += check_bursts(s);
+	bad += check_stream(s, other);
+
+	delete[] s;
+	delete[] other;
+
+	return bad? 1 : 0;
+}
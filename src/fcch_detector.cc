@@ -50,81 +50,86 @@
 
 extern int g_debug;
 
-static const char * const fftw_plan_name = ".kal_fftw_plan";
+static const unsigned int MIN_PM = 50; // XXX arbitrary, depends on decimation
+static const float MIN_COHERENCE = 50.0 / 148.0; // about MIN_PM for a full burst
+static const unsigned int EDGE_RUN = 4;	// samples in a row that fit the line
+static const unsigned int EDGE_PASSES = 3;
+static const double EDGE_MIN = 0.05;	// radians
 const unsigned int fcch_detector::FFT_SIZE = 1024;
+const unsigned int fcch_detector::FFT_BATCH = 8;
+const unsigned int fcch_detector::SPLIT_LEN = 4096;
+const unsigned int fcch_detector::STREAM_AVG_FRAMES = 12;
 
 
 fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
    const float p, const float G) {
 
-	FILE *plan_fp;
-	char plan_name[BUFSIZ];
-	const char *home;
-
+	m_estimator = FCCH_EST_FFT;
 	m_D = D;
 	m_p = p;
 	m_G = G;
 	m_e = 0.0;
 
 	m_sample_rate = sample_rate;
-	m_fcch_burst_len =
-	   (unsigned int)(148.0 * (m_sample_rate / GSM_RATE));
+	m_sps = m_sample_rate / GSM_RATE;
+	m_fcch_burst_len = (unsigned int)(148.0 * m_sps);
+	m_min_fb_len = 100 * m_sps;
+	m_avg_len = (unsigned int)(STREAM_AVG_FRAMES * 8 * 156.25 * m_sps);
+	m_warmup = (unsigned int)(8 * 156.25 * m_sps);
+	low_to_high_init(&m_run);
 
 	m_filter_delay = 8;
 	m_w_len = 2 * m_filter_delay + 1;
-	m_w = new complex[m_w_len];
-	memset(m_w, 0, sizeof(complex) * m_w_len);
-
-	m_x_cb = new circular_buffer(1024, sizeof(complex), 0);
-	m_y_cb = new circular_buffer(1024, sizeof(complex), 1);
-	m_e_cb = new circular_buffer(1000000, sizeof(float), 0);
-
-	m_in = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * FFT_SIZE);
-	m_out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * FFT_SIZE);
-	if((!m_in) || (!m_out))
-		throw std::runtime_error("fcch_detector: fftw_malloc failed!");
-
-	home = getenv("HOME");
-	if(strlen(home) + strlen(fftw_plan_name) + 2 < sizeof(plan_name)) {
-		strcpy(plan_name, home);
-		strcat(plan_name, "/");
-		strcat(plan_name, fftw_plan_name);
-		if((plan_fp = fopen(plan_name, "r"))) {
-			fftw_import_wisdom_from_file(plan_fp);
-			fclose(plan_fp);
-		}
-		m_plan = fftw_plan_dft_1d(FFT_SIZE, m_in, m_out, FFTW_FORWARD,
-		   FFTW_MEASURE);
-		if((plan_fp = fopen(plan_name, "w"))) {
-			fftw_export_wisdom_to_file(plan_fp);
-			fclose(plan_fp);
-		}
-	} else
-		m_plan = fftw_plan_dft_1d(FFT_SIZE, m_in, m_out, FFTW_FORWARD,
-		   FFTW_ESTIMATE);
-	if(!m_plan)
+	m_wr = new float[m_w_len];
+	m_wi = new float[m_w_len];
+	memset(m_wr, 0, sizeof(float) * m_w_len);
+	memset(m_wi, 0, sizeof(float) * m_w_len);
+	m_xr = new float[SPLIT_LEN];
+	m_xi = new float[SPLIT_LEN];
+	m_sr = new float[SPLIT_LEN];
+	m_si = new float[SPLIT_LEN];
+	m_phase = new float[m_fcch_burst_len];
+	m_z = new complex[m_fcch_burst_len];
+	m_burst = new complex[m_fcch_burst_len];
+	m_err = 0;
+	m_err_len = 0;
+	m_run_max = 0;
+	m_score_max = 0.0;
+	stream_reset();
+	m_lms = lms_kernels_select(m_w_len);
+	if(g_debug)
+		printf("debug: lms kernels: %s\n", m_lms->name);
+
+	m_x_cb = new spsc_circular_buffer(1024, sizeof(complex));
+
+	m_fft = fft_alloc(FFT_SIZE * FFT_BATCH);
+	if(!m_fft)
+		throw std::runtime_error("fcch_detector: fftwf_malloc failed!");
+
+	m_plan = fft_plan(FFT_SIZE, 1, FFTW_FORWARD, FFTW_MEASURE);
+	m_plan_batch = fft_plan(FFT_SIZE, FFT_BATCH, FFTW_FORWARD, FFTW_MEASURE);
+	if((!m_plan) || (!m_plan_batch))
 		throw std::runtime_error("fcch_detector: fftw plan failed!");
 }
 
 
 fcch_detector::~fcch_detector() {
 
-	if(m_w) {
-		delete[] m_w;
-		m_w = 0;
-	}
+	delete[] m_wr;
+	delete[] m_wi;
+	delete[] m_xr;
+	delete[] m_xi;
+	delete[] m_sr;
+	delete[] m_si;
+	delete[] m_phase;
+	delete[] m_z;
+	delete[] m_burst;
+	delete[] m_err;
 	if(m_x_cb) {
 		delete m_x_cb;
 		m_x_cb = 0;
 	}
-	if(m_y_cb) {
-		delete m_y_cb;
-		m_y_cb = 0;
-	}
-	if(m_e_cb) {
-		delete m_e_cb;
-		m_e_cb = 0;
-	}
+	fft_free(m_fft);
 }
 
 
@@ -133,37 +138,33 @@ enum {
 	HIGH	= 1
 };
 
-static unsigned int g_count = 0,
-		    g_block_s = HIGH;
+void fcch_detector::low_to_high_init(low_run *r) {
 
-
-static inline void low_to_high_init() {
-
-	g_count = 0;
-	g_block_s = HIGH;
+	r->count = 0;
+	r->block_s = HIGH;
 }
 
 
-static inline unsigned int low_to_high(float e, float a) {
+unsigned int fcch_detector::low_to_high(low_run *r, float e, float a) {
 
-	unsigned int r = 0;
+	unsigned int l = 0;
 
 	if(e > a) {
-		if(g_block_s == LOW) {
-			r = g_count;
-			g_block_s = HIGH;
-			g_count = 0;
+		if(r->block_s == LOW) {
+			l = r->count;
+			r->block_s = HIGH;
+			r->count = 0;
 		}
-		g_count += 1;
+		r->count += 1;
 	} else {
-		if(g_block_s == HIGH) {
-			g_block_s = LOW;
-			g_count = 0;
+		if(r->block_s == HIGH) {
+			r->block_s = LOW;
+			r->count = 0;
 		}
-		g_count += 1;
+		r->count += 1;
 	}
 
-	return r;
+	return l;
 }
 
 
@@ -197,90 +198,95 @@ static inline int peak_valley(complex *c, unsigned int c_len, complex peak, unsi
 }
 
 
-static inline float sinc(const float x) {
-
-	if((x <= -0.0001) || (0.0001 <= x))
-		return sinf(x) / x;
-	return 1.0;
-}
-
+/*
+ * The strongest bin in [lo, hi], and the average power of every other bin.
+ */
+static inline unsigned int peak_bin(const complex *fft, const unsigned int fft_size, const unsigned int lo, const unsigned int hi, float *avg_power) {
 
-static inline complex interpolate_point(const complex *s, const unsigned int s_len, const float s_i) {
+	unsigned int i, max_i = lo;
+	float max = -1.0, power, sum_power = 0;
 
-	static const unsigned int filter_len = 21;
+	for(i = 0; i < fft_size; i++) {
+		power = norm(fft[i]);
+		sum_power += power;
+		if((lo <= i) && (i <= hi) && (power > max)) {
+			max = power;
+			max_i = i;
+		}
+	}
 
-	int start, end, i;
-	unsigned int d;
-	complex point;
+	if(avg_power)
+		*avg_power = (sum_power - max) / (fft_size - 1);
 
-	d = (filter_len - 1) / 2;
-	start = (int)(floor(s_i) - d);
-	end = (int)(floor(s_i) + d + 1);
-	if(start < 0)
-		start = 0;
-	if(end > (int)(s_len - 1))
-		end = s_len - 1;
-	for(point = 0.0, i = start; i <= end; i++)
-		point += s[i] * sinc(M_PI * (i - s_i));
-	return point;
+	return max_i;
 }
 
 
-static inline float peak_detect(const complex *s, const unsigned int s_len, complex *peak, float *avg_power) {
+/*
+ * The DTFT of s at f cycles per sample.  The FFT bins are this sampled at
+ * k / fft_size, so the two are on the same scale.
+ */
+static inline complex dtft(const complex *s, const unsigned int s_len, const double f) {
 
-	unsigned int i;
-	float max = -1.0, max_i = -1.0, sample_power, sum_power, early_i, late_i, incr;
-	complex early_p, late_p, cmax;
+	float wr = cos(2.0 * M_PI * f), wi = -sin(2.0 * M_PI * f);
+	float rr = 1.0, ri = 0.0, sr = 0.0, si = 0.0, t;
 
-	sum_power = 0;
-	for(i = 0; i < s_len; i++) {
-		sample_power = norm(s[i]);
-		sum_power += sample_power;
-		if(sample_power > max) {
-			max = sample_power;
-			max_i = i;
-		}
-	}
-	early_i = (1 <= max_i)? (max_i - 1) : 0;
-	late_i = (max_i + 1 < s_len)? (max_i + 1) : s_len - 1;
-
-	incr = 0.5;
-	while(incr > 1.0 / 1024.0) {
-		early_p = interpolate_point(s, s_len, early_i);
-		late_p = interpolate_point(s, s_len, late_i);
-		if(norm(early_p) < norm(late_p))
-			early_i += incr;
-		else if(norm(early_p) > norm(late_p))
-			early_i -= incr;
-		else
-			break;
-		incr /= 2.0;
-		late_i = early_i + 2.0;
+	// spelled out, since complex * complex goes through a library call
+	for(unsigned int i = 0; i < s_len; i++) {
+		sr += s[i].real() * rr - s[i].imag() * ri;
+		si += s[i].real() * ri + s[i].imag() * rr;
+		t = rr * wr - ri * wi;
+		ri = rr * wi + ri * wr;
+		rr = t;
 	}
-	max_i = early_i + 1.0;
-	cmax = interpolate_point(s, s_len, max_i);
-
-	if(peak)
-		*peak = cmax;
 
-	if(avg_power)
-		*avg_power = (sum_power - norm(cmax)) / (s_len - 1);
-
-	return max_i;
+	return complex(sr, si);
 }
 
 
-static inline float itof(float index, float sample_rate, unsigned int fft_size) {
+/*
+ * Fine frequency estimate around FFT bin i.  The zero padded main lobe is
+ * many bins wide, so the vertex of a parabola through the bin and its
+ * neighbours is already within a few percent of a bin.  Then evaluate the
+ * DTFT directly at that estimate and a small step either side of it and
+ * take the vertex of the parabola through those.  Returns f in cycles per
+ * sample and the power at the vertex.
+ */
+static inline double zoom_peak(const complex *fft, const unsigned int fft_size, const unsigned int i, const complex *s, const unsigned int s_len, float *peak_power) {
+
+	static const unsigned int ZOOM_STAGES = 1;
+	static const double ZOOM_SHRINK = 8.0;
+
+	unsigned int stage;
+	double f, d, p_l, p_c, p_r, den, v;
+
+	p_l = norm(fft[(i + fft_size - 1) % fft_size]);
+	p_c = norm(fft[i]);
+	p_r = norm(fft[(i + 1) % fft_size]);
+	d = 1.0 / fft_size;
+	f = i * d;
+
+	for(stage = 0; ; stage++) {
+		den = p_l - 2.0 * p_c + p_r;
+		v = (den < 0.0)? 0.5 * (p_l - p_r) / den : 0.0;
+		if(v < -1.0)
+			v = -1.0;
+		if(v > 1.0)
+			v = 1.0;
+		f += v * d;
+		if(stage == ZOOM_STAGES)
+			break;
 
-	double r = index * (sample_rate / (double)fft_size);
+		d /= ZOOM_SHRINK;
+		p_l = norm(dtft(s, s_len, f - d));
+		p_c = norm(dtft(s, s_len, f));
+		p_r = norm(dtft(s, s_len, f + d));
+	}
 
-	/*
-	if(index > (double)fft_size / 2.0)
-		return r - sample_rate;
-	else
-		return r;
-	 */
-	return r;
+	if(peak_power)
+		*peak_power = p_c - 0.25 * (p_l - p_r) * v;
+
+	return f;
 }
 
 
@@ -297,31 +303,286 @@ static inline unsigned int ftoi(float frequency, float sample_rate, unsigned int
 #endif /* !MIN */
 
 
+static inline void fft_load(complex *fft, const unsigned int fft_size, const complex *s, const unsigned int s_len) {
+
+	unsigned int i, len = MIN(s_len, fft_size);
+
+	memcpy(fft, s, sizeof(complex) * len);
+	for(i = len; i < fft_size; i++)
+		fft[i] = 0;
+}
+
+
+/*
+ * The FCCH tone is at GSM_RATE / 4, so only look within OFFSET_MAX of that.
+ */
+float fcch_detector::fft_peak(const complex *fft, const complex *s, const unsigned int s_len, float *pm) {
+
+	unsigned int i, lo, hi, len = MIN(s_len, FFT_SIZE);
+	float avg_power, peak_power;
+	double f;
+
+	lo = ftoi(GSM_RATE / 4 - OFFSET_MAX, m_sample_rate, FFT_SIZE);
+	hi = ftoi(GSM_RATE / 4 + OFFSET_MAX, m_sample_rate, FFT_SIZE) + 1;
+	if(hi > FFT_SIZE / 2)
+		hi = FFT_SIZE / 2;
+
+	i = peak_bin(fft, FFT_SIZE, lo, hi, &avg_power);
+	f = zoom_peak(fft, FFT_SIZE, i, s, len, &peak_power);
+	if(pm)
+		*pm = peak_power / avg_power;
+	return f * m_sample_rate;
+}
+
+
 float fcch_detector::freq_detect(const complex *s, const unsigned int s_len, float *pm) {
 
-	unsigned int i, len;
-	float max_i, avg_power;
-	complex fft[FFT_SIZE], peak;
+	fft_load(m_fft, FFT_SIZE, s, s_len);
+	fft_execute(m_plan, m_fft);
+
+	return fft_peak(m_fft, s, s_len, pm);
+}
+
+
+/*
+ * z[t] = s[t] e^(-j omega t)
+ */
+static inline void demodulate(const complex *s, const unsigned int s_len, const double omega, complex *z) {
+
+	double rr = 1.0, ri = 0.0, wr = cos(omega), wi = -sin(omega), t;
 
-	len = MIN(s_len, FFT_SIZE);
-	for(i = 0; i < len; i++) {
-		m_in[i][0] = s[i].real();
-		m_in[i][1] = s[i].imag();
+	for(unsigned int i = 0; i < s_len; i++) {
+		z[i] = complex(s[i].real() * rr - s[i].imag() * ri,
+		   s[i].real() * ri + s[i].imag() * rr);
+		t = rr * wr - ri * wi;
+		ri = rr * wi + ri * wr;
+		rr = t;
 	}
-	for(i = len; i < FFT_SIZE; i++) {
-		m_in[i][0] = 0;
-		m_in[i][1] = 0;
+}
+
+
+/*
+ * sum z[t + l] conj(z[t]), spelled out since complex * complex goes through a
+ * library call
+ */
+static inline complex lag_sum(const complex *z, const unsigned int z_len, const unsigned int l) {
+
+	float sr = 0.0, si = 0.0;
+
+	for(unsigned int t = 0; t + l < z_len; t++) {
+		sr += z[t + l].real() * z[t].real() + z[t + l].imag() * z[t].imag();
+		si += z[t + l].imag() * z[t].real() - z[t + l].real() * z[t].imag();
 	}
 
-	fftw_execute(m_plan);
+	return complex(sr, si);
+}
+
+
+/*
+ * Fit a line to p[lo .. hi - 1] weighted by |z[t]|^2.  Returns the slope and
+ * sets the weighted means and the weighted sums of the weights, of the
+ * squared distances from t_mean and of the squared residuals.
+ */
+static double line_fit(const float *p, const complex *z, const unsigned int lo, const unsigned int hi, double *t_mean, double *p_mean, double *sum_a, double *sum_tt, double *sum_r) {
 
-	for(i = 0; i < FFT_SIZE; i++)
-		fft[i] = complex(m_out[i][0], m_out[i][1]);
+	unsigned int t;
+	double a, r, slope, sum_t = 0.0, sum_p = 0.0, sum_tp = 0.0;
 
-	max_i = peak_detect(fft, FFT_SIZE, &peak, &avg_power);
-	if(pm)
-		*pm = norm(peak) / avg_power;
-	return itof(max_i, m_sample_rate, FFT_SIZE);
+	*sum_a = 0.0;
+	for(t = lo; t < hi; t++) {
+		a = norm(z[t]);
+		*sum_a += a;
+		sum_t += a * t;
+		sum_p += a * p[t];
+	}
+	*t_mean = sum_t / *sum_a;
+	*p_mean = sum_p / *sum_a;
+	*sum_tt = 0.0;
+	for(t = lo; t < hi; t++) {
+		a = norm(z[t]);
+		*sum_tt += a * (t - *t_mean) * (t - *t_mean);
+		sum_tp += a * (t - *t_mean) * (p[t] - *p_mean);
+	}
+	slope = sum_tp / *sum_tt;
+	*sum_r = 0.0;
+	for(t = lo; t < hi; t++) {
+		r = p[t] - *p_mean - slope * (t - *t_mean);
+		*sum_r += norm(z[t]) * r * r;
+	}
+
+	return slope;
+}
+
+
+/*
+ * Least-squares fit to the phase of the burst, which is Kay's weighted phase
+ * difference estimator,
+ *
+ *	S. Kay, "A Fast and Accurate Single Frequency Estimator," IEEE Trans.
+ *	ASSP, vol. 37, no. 12, 1989,
+ *
+ * written as the line fit it is equivalent to at high SNR.  The phase
+ * differences of an FCCH burst are a quarter turn each, which leaves so
+ * little room before noise wraps them that the plain estimator falls apart
+ * below about 20 dB.  So:
+ *
+ *	1.  remove the frequency given by the phase of the summed lag one
+ *	    products, a robust but less precise estimate, refined with the
+ *	    same at lags of 8 and 32 samples,
+ *	2.  take each sample's phase relative to the mean phase, which never
+ *	    needs unwrapping since what is left drifts by much less than a turn,
+ *	3.  fit a line to those phases weighted by |s[t]|^2, roughly the
+ *	    inverse of each phase's variance, so that the samples where noise
+ *	    nearly cancels the tone don't count for much,
+ *	4.  drop any samples at either end that are well off the line and fit
+ *	    again.  The low error neighborhood rarely matches the burst to the
+ *	    sample, and every modulated symbol it takes in from around the
+ *	    burst pulls the phase a quarter turn the wrong way.
+ *
+ * The slope's variance comes from the weighted residuals.  The coherence,
+ * |sum s[t + m] conj(s[t])| / sum |s[t]|^2 at a lag of one symbol, is near
+ * 1 for a pure tone and near 0 for noise or normal bursts.
+ */
+float fcch_detector::phase_detect(const complex *s, const unsigned int s_len, float *coherence, float *variance) {
+
+	unsigned int t, l, m, k, lo, hi, new_lo, new_hi, n = MIN(s_len, m_fcch_burst_len);
+	double omega, t_mean, p_mean, sum_a, sum_tt, sum_r, slope, limit,
+	   power = 0.0;
+	complex lag, mean = 0.0, rot;
+
+	if(n < 3) {
+		if(coherence)
+			*coherence = 0.0;
+		return 0.0;
+	}
+
+	// 1. coarse frequency, refined at longer lags while those are still
+	// unambiguous
+	omega = std::arg(lag_sum(s, n, 1));
+	for(l = 8; l < n / 2; l *= 4) {
+		demodulate(s, n, omega, m_z);
+		omega += std::arg(lag_sum(m_z, n, l)) / l;
+	}
+
+	// 2. remove it and measure phase against the mean
+	demodulate(s, n, omega, m_z);
+	for(t = 0; t < n; t++)
+		mean += m_z[t];
+	rot = std::conj(mean) / std::abs(mean);
+	for(t = 0; t < n; t++) {
+		m_phase[t] = atan2f(m_z[t].imag() * rot.real() + m_z[t].real() * rot.imag(),
+		   m_z[t].real() * rot.real() - m_z[t].imag() * rot.imag());
+	}
+
+	// 3. weighted line fit
+	lo = 0;
+	hi = n;
+	slope = line_fit(m_phase, m_z, lo, hi, &t_mean, &p_mean, &sum_a, &sum_tt, &sum_r);
+
+	// 4. trim the ends back to where a few samples in a row fit, and refit
+	// until nothing more comes off
+	for(k = 0; k < EDGE_PASSES; k++) {
+		limit = 3.0 * sqrt(sum_r / sum_a);
+		if(limit < EDGE_MIN)
+			limit = EDGE_MIN;
+		new_lo = lo;
+		new_hi = hi;
+		for(m = 0; (new_lo < hi) && (m < EDGE_RUN); new_lo++) {
+			m = (fabs(m_phase[new_lo] - p_mean - slope * (new_lo - t_mean)) < limit)? m + 1 : 0;
+		}
+		new_lo -= m;
+		for(m = 0; (new_hi > new_lo) && (m < EDGE_RUN); new_hi--) {
+			m = (fabs(m_phase[new_hi - 1] - p_mean - slope * (new_hi - 1 - t_mean)) < limit)? m + 1 : 0;
+		}
+		new_hi += m;
+		if(((new_lo == lo) && (new_hi == hi)) || (new_hi - new_lo < n / 2))
+			break;
+		lo = new_lo;
+		hi = new_hi;
+		slope = line_fit(m_phase, m_z, lo, hi, &t_mean, &p_mean, &sum_a, &sum_tt, &sum_r);
+	}
+	omega += slope;
+
+	if(variance) {
+		*variance = (sum_r / (hi - lo - 2)) / sum_tt *
+		   (m_sample_rate / (2.0 * M_PI)) * (m_sample_rate / (2.0 * M_PI));
+	}
+
+	if(coherence) {
+		m = (unsigned int)(m_sps + 0.5);
+		lag = lag_sum(s, n, m);
+		for(t = 0; t < n; t++)
+			power += norm(s[t]);
+		*coherence = (power > 0.0)? std::abs(lag) / power : 0.0;
+	}
+
+	return omega * m_sample_rate / (2.0 * M_PI);
+}
+
+
+/*
+ * Transform up to FFT_BATCH candidate neighborhoods together and store each
+ * one that looks like a pure tone in b, at most b_max of them.  Returns the
+ * number stored.
+ */
+unsigned int fcch_detector::freq_detect_batch(const complex *s, const unsigned int *y_offset, const unsigned int *l_count, const unsigned int n, fcch_burst *b, const unsigned int b_max) {
+
+	unsigned int k, found = 0, y_len[FFT_BATCH];
+	float loff, pm, snr, var = 0.0;
+
+	for(k = 0; k < n; k++)
+		y_len[k] = (l_count[k] < m_fcch_burst_len)? l_count[k] : m_fcch_burst_len;
+
+	if(m_estimator == FCCH_EST_PHASE) {
+		for(k = 0; (k < n) && (found < b_max); k++) {
+			loff = phase_detect(s + y_offset[k], y_len[k], &pm, &var);
+			if(g_debug)
+				printf("debug: %.0f\t%f\t%f\n", (double)l_count[k] / m_sps, pm, loff);
+			if(pm / MIN_COHERENCE > m_score_max)
+				m_score_max = pm / MIN_COHERENCE;
+			if(pm > MIN_COHERENCE) {
+				b[found].pos = y_offset[k];
+				b[found].offset = loff;
+				b[found].pm = pm;
+				b[found].variance = var;
+				found += 1;
+			}
+		}
+		return found;
+	}
+
+	for(k = 0; k < n; k++)
+		fft_load(m_fft + k * FFT_SIZE, FFT_SIZE, s + y_offset[k], y_len[k]);
+
+	if(n == FFT_BATCH)
+		fft_execute(m_plan_batch, m_fft);
+	else {
+		for(k = 0; k < n; k++)
+			fft_execute(m_plan, m_fft + k * FFT_SIZE);
+	}
+
+	for(k = 0; (k < n) && (found < b_max); k++) {
+		loff = fft_peak(m_fft + k * FFT_SIZE, s + y_offset[k], y_len[k], &pm);
+		if(g_debug)
+			printf("debug: %.0f\t%f\t%f\n", (double)l_count[k] / m_sps, pm, loff);
+		if(pm / MIN_PM > m_score_max)
+			m_score_max = pm / MIN_PM;
+		if(pm > MIN_PM) {
+			b[found].pos = y_offset[k];
+			b[found].offset = loff;
+			b[found].pm = pm;
+
+			// no direct measure, so use the Cramer-Rao bound with the
+			// SNR that the peak to mean ratio implies
+			snr = (pm < y_len[k])? pm / (y_len[k] - pm) : pm;
+			b[found].variance = 6.0 * m_sample_rate * m_sample_rate /
+			   (4.0 * M_PI * M_PI * snr * y_len[k] *
+			   ((double)y_len[k] * y_len[k] - 1.0));
+			found += 1;
+		}
+	}
+
+	return found;
 }
 
 
@@ -335,37 +596,42 @@ static inline void display_complex(const complex *s, unsigned int s_len) {
 
 
 /*
- * scan:
+ * scan_bursts:
  * 	1.  calculate average error
  * 	2.  find neighborhoods with low error that satisfy minimum length
  * 	3.  for each such neighborhood, take fft and calculate peak/mean
  * 	4.  if peak/mean > 50, then this is a valid finding.
+ *
+ * With FCCH_EST_PHASE, steps 3 and 4 use phase_detect() and its coherence
+ * instead.  Every valid finding in s is stored in b, in the order they
+ * occur, until b_max are found.  Returns the number stored.  get_evidence()
+ * then tells how close the rest of s came to holding a burst.
  */
-unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, float *offset, unsigned int *consumed) {
-
-	static const float sps = m_sample_rate / (1625000.0 / 6.0);
-	static const unsigned int MIN_FB_LEN = 100 * sps;
-	static const unsigned int MIN_PM = 50; // XXX arbitrary, depends on decimation
+unsigned int fcch_detector::scan_bursts(const complex *s, const unsigned int s_len, fcch_burst *b, const unsigned int b_max, unsigned int *consumed) {
 
-	unsigned int len = 0, t, e_count, i, l_count, y_offset, y_len;
-	float e, *a, loff = 0, pm;
+	unsigned int e_count, i, l_count, n = 0, found = 0;
+	unsigned int y_offset[FFT_BATCH], y_count[FFT_BATCH];
+	float *a;
 	double sum = 0.0, avg, limit;
-	const complex *y;
 
 	// calculate the error for each sample
-	while(len < s_len) {
-		t = m_x_cb->write(s + len, 1);
-		len += t;
-		if(!next_norm_error(&e)) {
-			m_e_cb->write(&e, 1);
-			sum += e;
-		}
+	if(s_len > m_err_len) {
+		delete[] m_err;
+		m_err_len = s_len;
+		m_err = new float[m_err_len];
 	}
+	a = m_err;
+	m_run_max = 0;
+	m_score_max = 0.0;
+	e_count = next_norm_errors(s, s_len, a);
+	for(i = 0; i < e_count; i++)
+		sum += a[i];
 	if(consumed)
-		*consumed = len;
+		*consumed = s_len;
+	if(!e_count)
+		return 0;
 
 	// calculate average error over entire buffer
-	a = (float *)m_e_cb->peek(&e_count);
 	avg = sum / (double)e_count;
 	limit = 0.7 * avg;
 
@@ -374,37 +640,56 @@ unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, flo
 	}
 
 	// find neighborhoods where the error is smaller than the limit
-	low_to_high_init();
-	for(i = 0; i < e_count; i++) {
-		l_count = low_to_high(a[i], limit);
-
-		// see if p/m indicates a pure tone
-		pm = 0;
-		if(l_count >= MIN_FB_LEN) {
-			y_offset = i - l_count;
-			y_len = (l_count < m_fcch_burst_len)? l_count : m_fcch_burst_len;
-			y = s + y_offset;
-			loff = freq_detect(y, y_len, &pm);
-			if(g_debug)
-				printf("debug: %.0f\t%f\t%f\n", (double)l_count / sps, pm, loff);
-			if(pm > MIN_PM)
-				break;
+	low_to_high_init(&m_run);
+	for(i = 0; (i < e_count) && (found < b_max); i++) {
+		l_count = low_to_high(&m_run, a[i], limit);
+		if(l_count > m_run_max)
+			m_run_max = l_count;
+		if(l_count >= m_min_fb_len) {
+			y_offset[n] = i - l_count;
+			y_count[n] = l_count;
+			n += 1;
+		}
+
+		// see if p/m indicates a pure tone, a batch of candidates at a time
+		if((n == FFT_BATCH) || (n && (i == e_count - 1))) {
+			found += freq_detect_batch(s, y_offset, y_count, n, b + found, b_max - found);
+			n = 0;
 		}
 	}
 	// empty buffers for next call
-	m_e_cb->flush();
 	m_x_cb->flush();
-	m_y_cb->flush();
 
-	if(pm <= MIN_PM)
+	if(g_debug && found) {
+		printf("debug: fcch_detector finished -----------------------------\n");
+	}
+
+	return found;
+}
+
+
+void fcch_detector::get_evidence(fcch_evidence *e) {
+
+	e->run = (float)m_run_max / m_fcch_burst_len;
+	e->score = m_score_max;
+}
+
+
+/*
+ * Return 1 with the offset of the first burst in s, or 0.  If variance is
+ * given it is set to the variance (Hz^2) of the returned offset.
+ */
+unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, float *offset, unsigned int *consumed, float *variance) {
+
+	fcch_burst b;
+
+	if(!scan_bursts(s, s_len, &b, 1, consumed))
 		return 0;
 
 	if(offset)
-		*offset = loff;
-
-	if(g_debug) {
-		printf("debug: fcch_detector finished -----------------------------\n");
-	}
+		*offset = b.offset;
+	if(variance)
+		*variance = b.variance;
 
 	return 1;
 }
@@ -428,15 +713,12 @@ unsigned int fcch_detector::filter_len() {
 }
 
 
-static float vectornorm2(const complex *v, const unsigned int len) {
-
-	unsigned int i;
-	float e = 0.0;
-
-	for(i = 0; i < len; i++)
-		e += norm(v[i]);
+static inline void split(const complex *s, const unsigned int s_len, float *r, float *i) {
 
-	return e;
+	for(unsigned int k = 0; k < s_len; k++) {
+		r[k] = s[k].real();
+		i[k] = s[k].imag();
+	}
 }
 
 
@@ -446,47 +728,60 @@ static float vectornorm2(const complex *v, const unsigned int len) {
  * 	y[0] = X(x[0], ..., x[w_len - 1 + m_D])
  *
  * So y and e are delayed by w_len - 1 + m_D.
+ *
+ * xr and xi must hold at least w_len + m_D samples.  The taps are kept in
+ * reverse, m_wr[j] and m_wi[j] applying to x[j], which is w[n - j] in the
+ * notation above.  Returns the error ratio.
  */
-int fcch_detector::next_norm_error(float *error) {
+float fcch_detector::lms_step(const float *xr, const float *xi) {
 
-	unsigned int i, n, max;
-	float E;
-	complex *x, y, e;
+	unsigned int n;
+	float E, yr, yi;
+	complex e, g;
 
 	// n is "current" sample
 	n = m_w_len - 1;
 
-	// ensure there are enough samples in the buffer
-	x = (complex *)m_x_cb->peek(&max);
-	if(n + m_D >= max)
-		return n + m_D - max + 1;
+	// calculate filtered value and input power
+	m_lms->energy_dot(m_wr, m_wi, xr, xi, m_w_len, &E, &yr, &yi);
 
 	// update G
-	E = vectornorm2(x, m_w_len);
 	if(m_G >= 2.0 / E)
 		m_G = 1.0 / E;
 
-	// calculate filtered value
-	y = 0.0;
-	for(i = 0; i < m_w_len; i++)
-		y += std::conj(m_w[i]) * x[n - i];
-	// m_y_cb->write(&y, 1);
-	m_y_cb->write(x + n + m_D, 1); // XXX save filtered value?
-
 	// calculate error from desired signal
-	e = x[n + m_D] - y;
+	e = complex(xr[n + m_D] - yr, xi[n + m_D] - yi);
 
 	// update filters with opposite gradient
-	for(i = 0; i < m_w_len; i++)
-		m_w[i] += m_G * std::conj(e) * x[n - i];
+	g = m_G * std::conj(e);
+	m_lms->update(m_wr, m_wi, xr, xi, m_w_len, g.real(), g.imag());
 
 	// update error average power
 	E /= m_w_len;
 	m_e = (1.0 - m_p) * m_e + m_p * norm(e);
 
 	// return error ratio
+	return m_e / E;
+}
+
+
+int fcch_detector::next_norm_error(float *error) {
+
+	unsigned int n, max;
+	complex *x;
+	float e;
+
+	n = m_w_len - 1;
+
+	// ensure there are enough samples in the buffer
+	x = (complex *)m_x_cb->peek(&max);
+	if(n + m_D >= max)
+		return n + m_D - max + 1;
+
+	split(x, n + m_D + 1, m_xr, m_xi);
+	e = lms_step(m_xr, m_xi);
 	if(error)
-		*error = m_e / E;
+		*error = e;
 
 	// remove the processed sample from the buffer
 	m_x_cb->purge(1);
@@ -495,21 +790,117 @@ int fcch_detector::next_norm_error(float *error) {
 }
 
 
-complex *fcch_detector::dump_x(unsigned int *x_len) {
+/*
+ * Runs the filter directly over a contiguous block, without going through
+ * m_x_cb.  The filter state carries over between calls but the input doesn't,
+ * so each block loses the first get_delay() samples exactly as a fresh m_x_cb
+ * would.  Writes one error ratio per remaining sample and returns the count.
+ */
+unsigned int fcch_detector::next_norm_errors(const complex *s, const unsigned int s_len, float *error) {
 
-	return (complex *)m_x_cb->peek(x_len);
+	unsigned int i, start, len, e_len = 0, delay = get_delay();
+
+	// split into real and imaginary parts a chunk at a time, overlapping
+	// each chunk by the filter delay
+	for(start = 0; start + delay < s_len; start += len - delay) {
+		len = MIN(s_len - start, SPLIT_LEN);
+		split(s + start, len, m_xr, m_xi);
+		for(i = 0; i + delay < len; i++)
+			error[e_len++] = lms_step(m_xr + i, m_xi + i);
+	}
+
+	return e_len;
 }
 
 
-complex *fcch_detector::dump_y(unsigned int *y_len) {
+/*
+ * Forget the stream position, the samples held over and the running error
+ * average, for instance after samples were dropped.  The filter taps are
+ * kept.
+ */
+void fcch_detector::stream_reset() {
+
+	m_hist = 0;
+	m_e_avg = 0.0;
+	m_e_n = 0;
+	m_s_pos = 0;
+	m_burst_n = 0;
+	low_to_high_init(&m_s_run);
+}
+
 
-	return (complex *)m_y_cb->peek(y_len);
+/*
+ * Incremental scan.  The samples in successive calls are one continuous
+ * stream, so the filter, the last get_delay() samples and any low error
+ * neighborhood in progress carry over between calls.  The error limit is
+ * 0.7 of a running average over about STREAM_AVG_FRAMES frames rather than of
+ * the whole buffer, and a burst is reported as soon as its neighborhood ends,
+ * with pos counted from the last stream_reset().
+ *
+ * Only the first m_fcch_burst_len samples of a neighborhood are kept, so the
+ * memory used doesn't depend on s_len.  Stops early once b_max bursts are
+ * found; *consumed is set to the number of samples of s taken, the rest must
+ * be passed again.
+ *
+ * The samples held over and the neighborhood in progress are the stream's
+ * own, so scan_bursts() and the other entry points can be called between
+ * stream() calls without losing them.  The filter itself is shared, and
+ * adapts to whatever it was given in between.
+ */
+unsigned int fcch_detector::stream(const complex *s, const unsigned int s_len, fcch_burst *b, const unsigned int b_max, unsigned int *consumed) {
+
+	unsigned int i, len, n, l_count, used = 0, found = 0, zero = 0,
+	   delay = get_delay();
+	float e, limit;
+
+	while((used < s_len) && (found < b_max)) {
+
+		// append the next chunk to the samples held over
+		len = MIN(s_len - used, SPLIT_LEN - m_hist);
+		split(s + used, len, m_sr + m_hist, m_si + m_hist);
+		used += len;
+		n = m_hist + len;
+
+		for(i = 0; (i + delay < n) && (found < b_max); i++) {
+			e = lms_step(m_sr + i, m_si + i);
+
+			// no neighborhoods until the average has settled
+			limit = (m_e_n < m_warmup)? -1.0 : 0.7 * m_e_avg;
+			m_e_n += 1;
+			m_e_avg += (e - m_e_avg) / ((m_e_n < m_avg_len)? m_e_n : m_avg_len);
+
+			l_count = low_to_high(&m_s_run, e, limit);
+			if(m_s_run.block_s == LOW) {
+				if(m_s_run.count == 1)
+					m_burst_n = 0;
+				if(m_burst_n < m_fcch_burst_len)
+					m_burst[m_burst_n++] = complex(m_sr[i], m_si[i]);
+			}
+			if(l_count >= m_min_fb_len) {
+				if(freq_detect_batch(m_burst, &zero, &l_count, 1, b + found, 1)) {
+					b[found].pos = m_s_pos - l_count;
+					found += 1;
+				}
+			}
+			m_s_pos += 1;
+		}
+
+		// hold over what the filter can't use yet
+		m_hist = n - i;
+		memmove(m_sr, m_sr + i, m_hist * sizeof(float));
+		memmove(m_si, m_si + i, m_hist * sizeof(float));
+	}
+
+	if(consumed)
+		*consumed = used;
+
+	return found;
 }
 
 
-unsigned int fcch_detector::y_buf_len() {
+complex *fcch_detector::dump_x(unsigned int *x_len) {
 
-	return m_y_cb->buf_len();
+	return (complex *)m_x_cb->peek(x_len);
 }
 
 
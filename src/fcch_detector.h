@@ -41,47 +41,129 @@
  * code should take that into consideration.
  */
 
-#include <fftw3.h>
-
 #include "circular_buffer.h"
 #include "complex.h"
+#include "fft_plan.h"
+#include "simd_kernels.h"
+
+/*
+ * How scan() estimates the frequency of a candidate burst.
+ *
+ *	FCCH_EST_FFT	peak of a zero padded FFT, zoomed in (the default)
+ *	FCCH_EST_PHASE	weighted least squares fit to the unwrapped phase of
+ *			the burst (Kay), no transform at all
+ */
+enum {
+	FCCH_EST_FFT	= 0,
+	FCCH_EST_PHASE	= 1
+};
+
+/*
+ * One burst found by scan_bursts() or stream(): its position in the scanned
+ * samples (or since stream_reset()), its frequency (Hz, the tone is nominally
+ * at GSM_RATE / 4), the detection score (peak to mean ratio, or coherence
+ * with FCCH_EST_PHASE) and the variance (Hz^2) of the frequency.
+ */
+struct fcch_burst {
+	unsigned long long pos;
+	float		offset,
+			pm,
+			variance;
+};
+
+/*
+ * What the last scan_bursts() saw, found or not: the longest run of low error
+ * as a fraction of an FCCH burst, and the best score of any candidate as a
+ * fraction of the score a burst needs (0 if there were no candidates).  A
+ * channel with no BTS rarely gets near 1 on either.
+ */
+struct fcch_evidence {
+	float		run,
+			score;
+};
 
 class fcch_detector {
 
 public:
 	fcch_detector(const float sample_rate, const unsigned int D = 8, const float p = 1.0 / 32.0, const float G = 1.0 / 12.5);
 	~fcch_detector();
-	unsigned int scan(const complex *s, const unsigned int s_len, float *offset, unsigned int *consumed);
+	unsigned int scan(const complex *s, const unsigned int s_len, float *offset, unsigned int *consumed, float *variance = 0);
+	unsigned int scan_bursts(const complex *s, const unsigned int s_len, fcch_burst *b, const unsigned int b_max, unsigned int *consumed);
+	unsigned int stream(const complex *s, const unsigned int s_len, fcch_burst *b, const unsigned int b_max, unsigned int *consumed);
+	void stream_reset();
 	float freq_detect(const complex *s, const unsigned int s_len, float *pm);
+	float phase_detect(const complex *s, const unsigned int s_len, float *coherence, float *variance);
+	void set_estimator(int estimator) { m_estimator = estimator; };
+	void set_kernels(const lms_kernels *k) { m_lms = k; };
+	void get_evidence(fcch_evidence *e);
 	unsigned int update(const complex *s, unsigned int s_len);
 	int next_norm_error(float *error);
+	unsigned int next_norm_errors(const complex *s, const unsigned int s_len, float *error);
 	complex *dump_x(unsigned int *);
-	complex *dump_y(unsigned int *);
 	unsigned int filter_delay() { return m_filter_delay; };
 	unsigned int get_delay();
 	unsigned int filter_len();
 	unsigned int x_buf_len();
-	unsigned int y_buf_len();
 	unsigned int x_purge(unsigned int);
 
 private:
+	float lms_step(const float *xr, const float *xi);
+	float fft_peak(const complex *fft, const complex *s, const unsigned int s_len, float *pm);
+	unsigned int freq_detect_batch(const complex *s, const unsigned int *y_offset, const unsigned int *l_count, const unsigned int n, fcch_burst *b, const unsigned int b_max);
+
+	// a run of samples on the same side of the error limit
+	struct low_run {
+		unsigned int	count,
+				block_s;
+	};
+	void low_to_high_init(low_run *r);
+	unsigned int low_to_high(low_run *r, float e, float a);
+
 	static constexpr double GSM_RATE = 1625000.0 / 6.0;
+	static constexpr float OFFSET_MAX = 40e3;
 	static const unsigned int FFT_SIZE;
+	static const unsigned int FFT_BATCH;
+	static const unsigned int SPLIT_LEN;
+	static const unsigned int STREAM_AVG_FRAMES;
+	int		m_estimator;
 	unsigned int	m_w_len,
 			m_D,
 			m_check_G,
 			m_filter_delay,
 			m_lpf_len,
-			m_fcch_burst_len;
+			m_fcch_burst_len,
+			m_min_fb_len,
+			m_avg_len,
+			m_warmup,
+			m_hist,
+			m_burst_n,
+			m_err_len,
+			m_run_max;
+	unsigned long long m_e_n,
+			m_s_pos;
+	double		m_e_avg;
+	low_run		m_run,		// scan_bursts()
+			m_s_run;	// stream()
 	float		m_sample_rate,
+			m_sps,
 			m_p,
 			m_G,
-			m_e;
-	complex 	*m_w;
-	circular_buffer *m_x_cb,
-			*m_y_cb,
-			*m_e_cb;
+			m_e,
+			m_score_max;
+	float		*m_wr,
+			*m_wi,
+			*m_xr,
+			*m_xi,
+			*m_sr,		// stream() input held over
+			*m_si,
+			*m_phase;
+	complex		*m_z,
+			*m_burst;
+	float		*m_err;
+	const lms_kernels *m_lms;
+	circular_buffer *m_x_cb;
 
-	fftw_complex	*m_in, *m_out;
-	fftw_plan	m_plan;
+	complex		*m_fft;
+	fftwf_plan	m_plan,
+			m_plan_batch;
 };
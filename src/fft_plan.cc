@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "fft_plan.h"
+
+static const char * const fftw_plan_name = ".kal_fftwf_plan";
+
+struct plan_entry {
+	unsigned int		n,
+				howmany,
+				flags;
+	int			sign;
+	fftwf_plan		plan;
+	struct plan_entry	*next;
+};
+
+static pthread_mutex_t plan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct plan_entry *plan_list = 0;
+static int wisdom_loaded = 0;
+
+
+static int wisdom_path(char *path, size_t path_len) {
+
+	const char *home;
+	int r;
+
+	if(!(home = getenv("HOME")) || !*home)
+		return -1;
+	r = snprintf(path, path_len, "%s/%s", home, fftw_plan_name);
+	if((r < 0) || ((size_t)r >= path_len))
+		return -1;
+
+	return 0;
+}
+
+
+/*
+ * Read the wisdom file the first time a measured plan is needed.
+ */
+static void wisdom_load() {
+
+	char path[BUFSIZ];
+	FILE *fp;
+
+	if(wisdom_loaded)
+		return;
+	wisdom_loaded = 1;
+
+	if(wisdom_path(path, sizeof(path)))
+		return;
+	if((fp = fopen(path, "r"))) {
+		fftwf_import_wisdom_from_file(fp);
+		fclose(fp);
+	}
+}
+
+
+/*
+ * Written to a temporary name and renamed so that another kal starting up
+ * never reads a partial file.  Failure (e.g., a read-only home) just means
+ * the next run measures again.
+ */
+static void wisdom_save() {
+
+	char path[BUFSIZ], tmp[BUFSIZ];
+	FILE *fp;
+
+	if(wisdom_path(path, sizeof(path)))
+		return;
+	if(snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid()) >= (int)sizeof(tmp))
+		return;
+	if(!(fp = fopen(tmp, "w")))
+		return;
+	fftwf_export_wisdom_to_file(fp);
+	if(fclose(fp) || rename(tmp, path))
+		unlink(tmp);
+}
+
+
+static fftwf_plan make_plan(unsigned int n, unsigned int howmany, int sign,
+   unsigned int flags) {
+
+	int len = n, measure = !(flags & FFTW_ESTIMATE);
+	char *before = 0, *after;
+	complex *buf;
+	fftwf_plan plan;
+
+	// measuring overwrites the buffer, so plan on a scratch one
+	if(!(buf = fft_alloc(n * howmany)))
+		return 0;
+
+	if(measure) {
+		wisdom_load();
+		before = fftwf_export_wisdom_to_string();
+	}
+
+	plan = fftwf_plan_many_dft(1, &len, howmany, (fftwf_complex *)buf, 0,
+	   1, n, (fftwf_complex *)buf, 0, 1, n, sign, flags);
+
+	// only rewrite the file if this plan taught fftw something new
+	if(measure) {
+		after = fftwf_export_wisdom_to_string();
+		if(plan && before && after && strcmp(before, after))
+			wisdom_save();
+		free(before);
+		free(after);
+	}
+
+	fft_free(buf);
+	return plan;
+}
+
+
+/*
+ * Returns a plan for howmany in-place transforms of length n, making it the
+ * first time it's asked for.  Plans live until the process exits.
+ */
+fftwf_plan fft_plan(unsigned int n, unsigned int howmany, int sign,
+   unsigned int flags) {
+
+	struct plan_entry *e;
+	fftwf_plan plan = 0;
+
+	pthread_mutex_lock(&plan_mutex);
+	for(e = plan_list; e; e = e->next) {
+		if((e->n == n) && (e->howmany == howmany) &&
+		   (e->sign == sign) && (e->flags == flags)) {
+			plan = e->plan;
+			break;
+		}
+	}
+	if((!plan) && (plan = make_plan(n, howmany, sign, flags))) {
+		e = new plan_entry;
+		e->n = n;
+		e->howmany = howmany;
+		e->sign = sign;
+		e->flags = flags;
+		e->plan = plan;
+		e->next = plan_list;
+		plan_list = e;
+	}
+	pthread_mutex_unlock(&plan_mutex);
+
+	return plan;
+}
+
+
+complex *fft_alloc(unsigned int len) {
+
+	return (complex *)fftwf_malloc(sizeof(complex) * len);
+}
+
+
+void fft_free(complex *buf) {
+
+	fftwf_free(buf);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * fft_plan
+ *
+ *	A process-wide cache of single precision, in-place fftwf plans.  FFTW
+ *	planning isn't thread safe, so every plan is made here under one lock
+ *	and then shared by whoever asks for the same transform.  Executing a
+ *	plan is thread safe.
+ *
+ *	A plan covers howmany contiguous transforms of n points each.  Run it
+ *	with fft_execute() on a buffer from fft_alloc() (or an offset into one
+ *	that is a multiple of n), since the plans assume fftwf_malloc alignment.
+ */
+
+#pragma once
+
+#include <fftw3.h>
+
+#include "complex.h"
+
+fftwf_plan fft_plan(unsigned int n, unsigned int howmany, int sign, unsigned int flags);
+complex *fft_alloc(unsigned int len);
+void fft_free(complex *buf);
+
+static inline void fft_execute(fftwf_plan plan, complex *buf) {
+
+	fftwf_execute_dft(plan, (fftwf_complex *)buf, (fftwf_complex *)buf);
+}
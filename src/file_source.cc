@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <string>
+
+#include "file_source.h"
+
+extern int g_verbosity;
+
+
+file_source::file_source(double sample_rate) {
+
+	m_sample_rate = sample_rate;
+	m_center_freq = 0.0;
+	m_center_assumed = 0;
+	m_format = FMT_CF32;
+	m_map = 0;
+	m_map_len = 0;
+	m_cb = 0;
+	m_pos = 0;
+	m_len = 0;
+	m_ended = 0;
+	m_fe = frontend_kernels_select();
+	m_stats = capture_stats();
+}
+
+
+file_source::~file_source() {
+
+	delete m_cb;
+	if(m_map)
+		munmap(m_map, m_map_len);
+}
+
+
+static int has_suffix(const std::string &s, const char *suffix) {
+
+	size_t len = strlen(suffix);
+
+	return (s.size() >= len) && !s.compare(s.size() - len, len, suffix);
+}
+
+
+/*
+ * Find "key" in the JSON text and return a pointer to the start of its
+ * value, or 0.  Good enough for the flat SigMF fields used here.
+ */
+static const char *json_value(const char *json, const char *key) {
+
+	std::string k = std::string("\"") + key + "\"";
+	const char *p = strstr(json, k.c_str());
+
+	if(!p)
+		return 0;
+	p += k.size();
+	while((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+		p++;
+	if(*p++ != ':')
+		return 0;
+	while((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+		p++;
+
+	return p;
+}
+
+
+/*
+ * Take the data format, sample rate and center frequency from a SigMF
+ * metadata file.
+ */
+int file_source::read_meta(const char *path) {
+
+	FILE *fp;
+	char *json;
+	const char *v;
+	long len;
+	double d;
+
+	if(!(fp = fopen(path, "r"))) {
+		perror(path);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	rewind(fp);
+	if(len <= 0) {
+		fprintf(stderr, "error: %s: empty metadata\n", path);
+		fclose(fp);
+		return -1;
+	}
+	json = new char[len + 1];
+	len = fread(json, 1, len, fp);
+	json[len] = 0;
+	fclose(fp);
+
+	if((v = json_value(json, "core:datatype"))) {
+		if(!strncmp(v, "\"cf32_le\"", 9))
+			m_format = FMT_CF32;
+		else if(!strncmp(v, "\"ci16_le\"", 9))
+			m_format = FMT_CS16;
+		else {
+			fprintf(stderr, "error: %s: unsupported datatype %.16s\n", path, v);
+			delete[] json;
+			return -1;
+		}
+	}
+	if((v = json_value(json, "core:sample_rate")) && ((d = strtod(v, 0)) > 0.0))
+		m_sample_rate = d;
+	if((v = json_value(json, "core:frequency")) && ((d = strtod(v, 0)) > 0.0))
+		m_center_freq = d;
+
+	delete[] json;
+
+	return 0;
+}
+
+
+int file_source::open(const char *path) {
+
+	std::string data = path;
+	int fd;
+	struct stat st;
+	size_t item, n;
+	unsigned int cb_len;
+
+	// a SigMF recording is named by either of its files
+	if(has_suffix(data, ".sigmf-meta") || has_suffix(data, ".sigmf-data")) {
+		data.resize(data.size() - strlen("-meta"));
+		if(read_meta((data + "-meta").c_str()))
+			return -1;
+		data += "-data";
+	} else if(has_suffix(data, ".cs16") || has_suffix(data, ".ci16") ||
+	   has_suffix(data, ".sc16"))
+		m_format = FMT_CS16;
+
+	if(m_sample_rate <= 0.0) {
+		fprintf(stderr, "error: %s: unknown sample rate\n", data.c_str());
+		return -1;
+	}
+
+	if((fd = ::open(data.c_str(), O_RDONLY)) == -1) {
+		perror(data.c_str());
+		return -1;
+	}
+	if(fstat(fd, &st) == -1) {
+		perror("fstat");
+		::close(fd);
+		return -1;
+	}
+
+	item = (m_format == FMT_CS16)? 2 * sizeof(int16_t) : sizeof(complex);
+	n = st.st_size / item;
+	if(!n) {
+		fprintf(stderr, "error: %s: no samples\n", data.c_str());
+		::close(fd);
+		return -1;
+	}
+	if((m_format == FMT_CF32) && (n > UINT_MAX / sizeof(complex))) {
+		n = UINT_MAX / sizeof(complex);
+		fprintf(stderr, "warning: %s: only using the first %zu samples\n",
+		   data.c_str(), n);
+	}
+
+	// private and writable, so a careless consumer can't touch the file
+	m_map_len = n * item;
+	if((m_map = mmap(0, m_map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) ==
+	   MAP_FAILED) {
+		perror("mmap");
+		m_map = 0;
+		::close(fd);
+		return -1;
+	}
+	::close(fd);
+	madvise(m_map, m_map_len, MADV_SEQUENTIAL);
+	m_len = n;
+
+	// cs16 is converted into a ring as it is asked for
+	if(m_format == FMT_CS16) {
+		cb_len = CB_LEN;
+		if(m_sample_rate * CB_TIME > cb_len)
+			cb_len = (unsigned int)(m_sample_rate * CB_TIME);
+		m_cb = new spsc_circular_buffer(cb_len, sizeof(complex));
+	} else
+		m_cb = new mapped_buffer(m_map, n, sizeof(complex));
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "Playing back %s: %zu samples at %.0f Hz",
+		   data.c_str(), n, m_sample_rate);
+		if(m_center_freq > 0.0)
+			fprintf(stderr, ", %.1fMHz", m_center_freq / 1e6);
+		fprintf(stderr, "\n");
+	}
+
+	return 0;
+}
+
+
+/*
+ * Make num_samples readable, adding the newly readable samples to the
+ * statistics.  A cf32 recording is served by moving the end of the buffer
+ * along the mapping.  A cs16 one is converted from the mapping into the ring
+ * by the front end kernels, like lime_source's packets, so its samples come
+ * out in the same units as the radio's.  Once the recording runs out, the
+ * rest of it is made readable and 1 is returned.
+ */
+int file_source::fill(unsigned int num_samples, unsigned int *overrun) {
+
+	static const float no_dc[2] = {0, 0};
+
+	unsigned int avail, space, len;
+	float *b;
+	double sum[2] = {0, 0};
+
+	if(overrun)
+		*overrun = 0;
+
+	if(num_samples > m_cb->buf_len())
+		num_samples = m_cb->buf_len();
+
+	// the ring's free space may wrap, so it can take two goes
+	while((avail = m_cb->data_available()) < num_samples) {
+		b = (float *)m_cb->poke(&space);
+		len = (space < num_samples - avail)? space : num_samples - avail;
+		if(len > m_len - m_pos)
+			len = m_len - m_pos;
+		if(!len)
+			break;
+		if(m_format == FMT_CS16)
+			m_fe->convert_i16(b, (const int16_t *)m_map + 2 * m_pos, len,
+			   no_dc, sum, &m_stats.energy, &m_stats.peak);
+		else
+			m_fe->power(b, len, &m_stats.energy, &m_stats.peak);
+		m_stats.count += len;
+		m_pos += len;
+		m_cb->wrote(len);
+	}
+
+	if(avail < num_samples) {
+		if(!m_ended)
+			fprintf(stderr, "end of recording\n");
+		m_ended = 1;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * At the end of the recording, what is left is read and samples_read says
+ * how much that was.
+ */
+int file_source::read(complex *buf, unsigned int num_samples, unsigned int *samples_read) {
+
+	unsigned int n;
+
+	if(fill(num_samples, 0) < 0)
+		return -1;
+
+	n = m_cb->read(buf, num_samples);
+
+	if(samples_read)
+		*samples_read = n;
+
+	return 0;
+}
+
+
+/*
+ * The recording can't be retuned, and its samples are not shifted, so only
+ * its center frequency is accepted, to within TUNE_TOLERANCE.  If the center
+ * frequency isn't known, the first frequency asked for is taken as it.  The
+ * buffer and the statistics are emptied like a radio's, so a tune consumes
+ * the recording the same way, and ts is set to the position of the next
+ * sample.
+ */
+int file_source::tune(double freq, unsigned long long *ts) {
+
+	if(m_center_freq <= 0.0) {
+		m_center_freq = freq;
+		m_center_assumed = 1;
+	}
+	if(fabs(freq - m_center_freq) > TUNE_TOLERANCE) {
+		fprintf(stderr, "error: %.1fMHz is not in the recording, which is at "
+		   "%.1fMHz%s\n", freq / 1e6, m_center_freq / 1e6,
+		   m_center_assumed? " (as first tuned)" : "");
+		return -1;
+	}
+
+	m_cb->flush();
+	m_stats = capture_stats();
+	if(ts)
+		*ts = m_pos;
+
+	return 0;
+}
+
+
+void file_source::start() {
+
+}
+
+
+void file_source::stop() {
+
+}
+
+
+int file_source::flush(unsigned int flush_count) {
+
+	unsigned int n;
+
+	// a cs16 ring may be shorter than flush_count
+	m_cb->flush();
+	while(flush_count) {
+		n = (flush_count < m_cb->buf_len())? flush_count : m_cb->buf_len();
+		if(fill(n, 0) < 0)
+			return -1;
+		m_cb->flush();
+		if(m_ended)
+			break;
+		flush_count -= n;
+	}
+	m_stats = capture_stats();
+
+	return 0;
+}
+
+
+circular_buffer *file_source::get_buffer() {
+
+	return m_cb;
+}
+
+
+void file_source::get_stats(capture_stats *s) {
+
+	*s = m_stats;
+	s->peak = sqrtf(s->peak);
+}
+
+
+double file_source::sample_rate() {
+
+	return m_sample_rate;
+}
+
+
+/*
+ * The rate is whatever the recording was made at.
+ */
+int file_source::set_sample_rate(double sample_rate) {
+
+	return (fabs(sample_rate - m_sample_rate) < 1.0)? 0 : -1;
+}
+
+
+double file_source::center_freq() {
+
+	return m_center_freq;
+}
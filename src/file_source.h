@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * file_source
+ *
+ *	A radio_source that plays back a recording instead of a LimeSDR.  The
+ *	file is mapped and, for floats, fill() only moves the end of the
+ *	readable part of the mapping forward, so samples are served at memory
+ *	speed and nothing is copied.  There is no real time: samples only go
+ *	by as they are asked for, and there are never overruns.
+ *
+ *	Raw files hold interleaved I/Q as 32 bit floats (cf32) or 16 bit
+ *	integers (cs16, .cs16/.ci16/.sc16 suffix).  cs16 is converted by
+ *	fill() from the mapping into a ring as it is asked for, unscaled like
+ *	the radio's samples, so memory use doesn't grow with the recording.
+ *	For a SigMF recording, pass either the .sigmf-data or the .sigmf-meta
+ *	file; the format, sample rate and center frequency are taken from the
+ *	metadata.  Otherwise the sample rate is given to the constructor.
+ *
+ *	The samples are served as recorded, so tune() only accepts the
+ *	recording's own center frequency, or while that is unknown, one
+ *	frequency: whichever is tuned to first.
+ */
+
+#pragma once
+
+#include "radio_source.h"
+#include "simd_kernels.h"
+
+class file_source : public radio_source {
+public:
+	file_source(double sample_rate = 0.0);
+	~file_source();
+
+	int open(const char *path);
+	int read(complex *buf,
+		unsigned int num_samples,
+		unsigned int *samples_read);
+
+	int fill(unsigned int num_samples, unsigned int *overrun);
+	int tune(double freq, unsigned long long *ts = 0);
+	void start();
+	void stop();
+	int flush(unsigned int flush_count = FLUSH_COUNT);
+	circular_buffer *get_buffer();
+	void get_stats(capture_stats *s);
+
+	double sample_rate();
+	int set_sample_rate(double sample_rate);
+	double center_freq();
+
+private:
+	int read_meta(const char *path);
+
+	enum {
+		FMT_CF32	= 0,
+		FMT_CS16	= 1
+	};
+
+	/*
+	 * How far a tune may be from the center frequency, about as far as a
+	 * BTS may be from its channel.
+	 */
+	static constexpr double	TUNE_TOLERANCE	= 40e3;
+
+	// the cs16 ring holds at least CB_LEN samples, or CB_TIME seconds
+	static const unsigned int	CB_LEN		= (1 << 20);
+	static constexpr double		CB_TIME		= 0.25;
+
+	double			m_sample_rate,
+				m_center_freq;
+	int			m_center_assumed,
+				m_format;
+	void			*m_map;
+	size_t			m_map_len;
+	circular_buffer		*m_cb;
+	unsigned long long	m_pos,		// samples made readable
+				m_len;		// samples in the recording
+	int			m_ended;
+	const frontend_kernels	*m_fe;
+	capture_stats		m_stats;	// peak squared
+};
@@ -31,7 +31,8 @@
  *    Two functions:
  *
  * 	1.  Calculates the frequency offset between a local GSM tower and the
- * 	    LimeSDR clock.
+ * 	    LimeSDR clock.  With -I, the same is done on a recording, with -S
+ * 	    on a synthetic signal.
  *
  *	2.  Identifies the frequency of all GSM base stations in a given band.
  */
@@ -54,14 +55,21 @@
 #include <libgen.h>
 
 #include "lime_source.h"
+#include "file_source.h"
+#include "synth_source.h"
 #include "fcch_detector.h"
 #include "arfcn_freq.h"
 #include "offset.h"
 #include "c0_detect.h"
+#include "dac_trim.h"
+#include "cal_cache.h"
 #include "version.h"
 
 static const double GSM_RATE = 1625000.0 / 6.0;
 
+// a cached DAC trim taken further than this from now (C) is not used
+static const double CAL_TEMP_DRIFT = 10.0;
+
 
 int g_verbosity = 0;
 int g_debug = 0;
@@ -85,7 +93,16 @@ void usage(char *prog) {
 	printf("\t-A\tantenna LNAH or LNAL or LNAW, defaults to LNAH\n");
 	printf("\t-g\tgain (0.0 - 73.0), defaults to 36.5\n");
 	printf("\t-x\texternal reference input in Hz\n");
+	printf("\t-w\tscan using wideband captures (13 MHz per tune)\n");
+	printf("\t-e\tstop averaging once the offset is known to +/- this many Hz\n");
+	printf("\t-E\tburst frequency estimator (fft, phase), defaults to fft\n");
+	printf("\t-j\tscan captures on this many threads, defaults to 1\n");
+	printf("\t-p\tscan: chance of missing a weak BTS, defaults to 0.01\n");
+	printf("\t-N\tignore the per-board calibration cache\n");
 	printf("\t-v\tverbose\n");
+	printf("\t-I\tread samples from this cf32/cs16 or SigMF recording\n");
+	printf("\t-r\tsample rate of a raw recording, defaults to %.0f\n", GSM_RATE);
+	printf("\t-S\tuse a synthetic signal, e.g. arfcn=1,17:offset=250:snr=10\n");
 	printf("\t-D\tenable debug messages\n");
 	printf("\t-h\thelp\n");
 	exit(-1);
@@ -95,16 +112,23 @@ void usage(char *prog) {
 int main(int argc, char **argv) {
 
 	char *endptr;
-	int c, bi = BI_NOT_DEFINED, chan = -1, bts_scan = 0;
+	int c, bi = BI_NOT_DEFINED, chan = -1, bts_scan = 0, use_cache = 1,
+	   wideband = 0, estimator = FCCH_EST_FFT;
+	unsigned int workers = 1;
 	char *antenna_args = NULL;
 	char *subdev = NULL;
+	char *infile = NULL;
+	char *synth = NULL;
 	double fpga_master_clock_freq = 30.72e6;
 	double external_ref = -1.0;
-	float gain = 36.5;
-	double freq = -1.0, fd;
-	lime_source *u;
-
-	while((c = getopt(argc, argv, "f:c:s:b:R:A:g:F:x:vDh?")) != EOF) {
+	float gain = 36.5, tolerance = 0.0, miss_target = 0.01;
+	double freq = -1.0, fd, file_rate = GSM_RATE;
+	radio_source *u;
+	lime_source *lime = NULL;
+	file_source *file;
+	synth_source *syn;
+
+	while((c = getopt(argc, argv, "f:c:s:b:R:A:g:F:x:e:E:j:p:I:r:S:wNvDh?")) != EOF) {
 		switch(c) {
 			case 'f':
 				freq = strtod(optarg, 0);
@@ -161,6 +185,58 @@ int main(int argc, char **argv) {
 				external_ref = strtod(optarg, 0);
 				break;
 
+			case 'e':
+				tolerance = strtod(optarg, 0);
+				if(tolerance < 0.0)
+					usage(argv[0]);
+				break;
+
+			case 'E':
+				if(!strcmp(optarg, "fft"))
+					estimator = FCCH_EST_FFT;
+				else if(!strcmp(optarg, "phase"))
+					estimator = FCCH_EST_PHASE;
+				else {
+					fprintf(stderr, "error: bad estimator: "
+					   "``%s''\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+
+			case 'j':
+				workers = strtoul(optarg, 0, 0);
+				if((workers < 1) || (64 < workers))
+					usage(argv[0]);
+				break;
+
+			case 'p':
+				miss_target = strtod(optarg, 0);
+				if((miss_target <= 0.0) || (1.0 <= miss_target))
+					usage(argv[0]);
+				break;
+
+			case 'I':
+				infile = optarg;
+				break;
+
+			case 'S':
+				synth = optarg;
+				break;
+
+			case 'r':
+				file_rate = strtod(optarg, 0);
+				if(file_rate <= 0.0)
+					usage(argv[0]);
+				break;
+
+			case 'w':
+				wideband = 1;
+				break;
+
+			case 'N':
+				use_cache = 0;
+				break;
+
 			case 'v':
 				g_verbosity++;
 				break;
@@ -211,22 +287,38 @@ int main(int argc, char **argv) {
 		printf("debug: Gain                  :\t%f\n", gain);
 	}
 
-	// let the device decide on the decimation
-	u = new lime_source(GSM_RATE, fpga_master_clock_freq, external_ref);
-	if(!u) {
-		fprintf(stderr, "error: radio_source\n");
-		return -1;
-	}
-	if(u->open(subdev) == -1) {
-		fprintf(stderr, "error: radio_source::open\n");
-		return -1;
-	}
-	if (antenna_args) {
-		u->set_antenna(antenna_args);
-	}
-	if(!u->set_gain(gain)) {
-		fprintf(stderr, "error: radio_source::set_gain\n");
-		return -1;
+	if(synth) {
+		syn = new synth_source(GSM_RATE, bi);
+		if(syn->open(synth) == -1) {
+			fprintf(stderr, "error: synth_source::open\n");
+			return -1;
+		}
+		u = syn;
+	} else if(infile) {
+		file = new file_source(file_rate);
+		if(file->open(infile) == -1) {
+			fprintf(stderr, "error: file_source::open\n");
+			return -1;
+		}
+		u = file;
+	} else {
+		// let the device decide on the decimation
+		u = lime = new lime_source(GSM_RATE, fpga_master_clock_freq, external_ref);
+		if(!lime) {
+			fprintf(stderr, "error: radio_source\n");
+			return -1;
+		}
+		if(lime->open(subdev) == -1) {
+			fprintf(stderr, "error: radio_source::open\n");
+			return -1;
+		}
+		if (antenna_args) {
+			lime->set_antenna(antenna_args);
+		}
+		if(!lime->set_gain(gain)) {
+			fprintf(stderr, "error: radio_source::set_gain\n");
+			return -1;
+		}
 	}
 
 	if(!bts_scan) {
@@ -240,48 +332,43 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "Using %s channel %d (%.1fMHz)\n",
 		   bi_to_str(bi), chan, freq / 1e6);
 
-		if (external_ref == -1.0) {
-			float off;
-			uint16_t dac = (uint16_t) u->get_board_dac();
-			uint16_t delta = 1;
-			int max = 50;
-			float lowest = 100e6;
-			uint16_t dac_l = 0;
-			do {
-				fprintf(stderr, "================================================\n");
-				u->tune_dac(dac);
-				offset_detect(u, &off);
-				if (fabs(off) < fabs(lowest)) {
-					dac_l = dac;
-					lowest = off;
-				}
-				if (fabs(off) < 50) {
-					fprintf(stderr, "\nTest DAC trim value in range [%d-%d]\n", dac-6, dac+6);
-					for (int i = -6; i < 6; i++) {
-						fprintf(stderr, "================================================\n");
-						u->tune_dac(dac + i);
-						offset_detect(u, &off);
-						if (fabs(off) < fabs(lowest)) {
-							dac_l = dac + i;
-							lowest = off;
-						}
-					}
-					break;
+		// only the LimeSDR's own clock can be trimmed
+		if (lime && (external_ref == -1.0)) {
+			float lowest, slope = 0.0, temp;
+			uint16_t dac_l, dac = (uint16_t)lime->get_board_dac();
+			cal_entry ce;
+
+			// the VCTCXO moves with temperature, so the code goes stale
+			temp = lime->temperature();
+			if(use_cache && !cal_cache_load(lime->serial(), &ce)) {
+				if(fabs(temp - ce.temp) > CAL_TEMP_DRIFT) {
+					fprintf(stderr, "Not using cached calibration for %s: taken at %.1f C, board is at %.1f C\n",
+					   lime->serial(), ce.temp, temp);
+				} else {
+					fprintf(stderr, "Using cached calibration for %s: DAC trim %u (%.4f ppm per code, %.1f C)\n",
+					   lime->serial(), ce.dac, ce.slope, ce.temp);
+					dac = ce.dac;
+					slope = ce.slope * freq / 1e6;
 				}
+			}
 
-				if (off < 0)
-					dac -= delta;
-				if (off > 0)
-					dac += delta;
-				if (off == 0)
-					break;
-
-				if (max-- < 0) break;
-			} while (true);
+			if(dac_trim(lime, freq, dac, slope, tolerance, estimator, workers, &dac_l, &lowest, &slope)) {
+				fprintf(stderr, "error: dac_trim\n");
+				return -1;
+			}
 			fprintf(stderr, "Found lowest offset of %fHz at %fMHz (%f ppm) using DAC trim %u\n", lowest, freq/1e6, lowest/freq*1e6, dac_l);
-			u->tune_dac(dac_l);
+			lime->tune_dac(dac_l);
+
+			if(use_cache) {
+				ce.dac = dac_l;
+				ce.slope = slope / freq * 1e6;
+				ce.temp = temp;
+				ce.timestamp = time(0);
+				if(cal_cache_store(lime->serial(), &ce))
+					fprintf(stderr, "warning: could not update calibration cache\n");
+			}
 		} else {
-			offset_detect(u, NULL);
+			offset_detect(u, NULL, tolerance, estimator, workers);
 		}
 
 		delete u;
@@ -292,7 +379,7 @@ int main(int argc, char **argv) {
 	fprintf(stderr, "%s: Scanning for %s base stations.\n",
 	   basename(argv[0]), bi_to_str(bi));
 
-	c0_detect(u, bi);
+	c0_detect(u, bi, wideband, miss_target);
 
 	delete u;
 
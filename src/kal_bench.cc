@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kal_bench
+ *
+ *	Measurements behind the performance work, one section per part of the
+ *	code.  "make check" builds it but doesn't run it, since the numbers
+ *	depend on the machine.
+ *
+ *		kal_bench [section ...]
+ *
+ *	With no sections, runs every section that needs no radio.
+ *
+ *	ring	circular_buffer against spsc_circular_buffer, single item
+ *		write/peek/purge as the old scan() did it, and block transfers
+ *		between two threads
+ *	lms	fcch_detector's LMS filter over a block, in samples per second,
+ *		with every kernel set the CPU can run
+ *	startup	time to construct an fcch_detector, the first one in the
+ *		process (planning, wisdom) and the ones after it, as
+ *		offset_detect() does for every measurement
+ *	estimator
+ *		rms error and time per estimate of a 148 sample tone near
+ *		GSM_RATE / 4, for the zoomed FFT peak, the phase fit and, for
+ *		reference, the sinc interpolated binary search they replaced
+ *	lime	heap allocations made while lime_source receives and fill()
+ *		is called, after the stream has started (needs a LimeSDR, so
+ *		only run when asked for)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <new>
+
+#include "circular_buffer.h"
+#include "complex.h"
+#include "fcch_detector.h"
+#include "fft_plan.h"
+#include "lime_source.h"
+#include "simd_kernels.h"
+
+static const double		GSM_RATE	= 1625000.0 / 6.0;
+
+int g_verbosity = 0;
+int g_debug = 0;
+
+
+/*
+ * Every operator new in the process, from any thread.
+ */
+static std::atomic<unsigned long> g_allocs(0);
+
+void *operator new(size_t n) {
+
+	void *p;
+
+	g_allocs++;
+	if(!(p = malloc(n? n : 1)))
+		throw std::bad_alloc();
+	return p;
+}
+
+
+void operator delete(void *p) noexcept {
+
+	free(p);
+}
+
+
+void operator delete(void *p, size_t) noexcept {
+
+	free(p);
+}
+
+
+static double now() {
+
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+static float noise(unsigned int *seed) {
+
+	*seed = *seed * 1103515245 + 12345;
+	return (float)((*seed >> 16) & 0x7fff) / 0x4000 - 1.0;
+}
+
+
+/*
+ * ring
+ */
+static const unsigned int	RING_LEN	= 1 << 16;
+static const unsigned int	RING_OPS	= 10000000;
+static const unsigned int	RING_BLOCK	= 256;
+static const unsigned long long	RING_ITEMS	= 1ULL << 28;
+
+
+static double ring_single(circular_buffer *cb) {
+
+	complex x = 1.0, *p;
+	unsigned int i, len;
+	double t;
+
+	t = now();
+	for(i = 0; i < RING_OPS; i++) {
+		cb->write(&x, 1);
+		p = (complex *)cb->peek(&len);
+		x += p[0];
+		cb->purge(1);
+	}
+	t = now() - t;
+	if(x == complex(0.0))
+		printf("\n");
+
+	return RING_OPS / t;
+}
+
+
+static void *ring_producer(void *arg) {
+
+	circular_buffer *cb = (circular_buffer *)arg;
+	complex b[RING_BLOCK];
+	unsigned long long sent = 0;
+	unsigned int n;
+
+	for(n = 0; n < RING_BLOCK; n++)
+		b[n] = 0.0;
+	while(sent < RING_ITEMS) {
+		// give way to the consumer on small machines
+		if(!(n = cb->write(b, RING_BLOCK)))
+			sched_yield();
+		sent += n;
+	}
+
+	return 0;
+}
+
+
+static double ring_threads(circular_buffer *cb) {
+
+	complex b[RING_BLOCK];
+	unsigned long long got = 0;
+	unsigned int n;
+	pthread_t producer;
+	double t;
+
+	t = now();
+	pthread_create(&producer, 0, ring_producer, cb);
+	while(got < RING_ITEMS) {
+		if(!(n = cb->read(b, RING_BLOCK)))
+			sched_yield();
+		got += n;
+	}
+	pthread_join(producer, 0);
+	t = now() - t;
+
+	return RING_ITEMS / t;
+}
+
+
+static void bench_ring() {
+
+	circular_buffer *m = new circular_buffer(RING_LEN, sizeof(complex));
+	spsc_circular_buffer *s = new spsc_circular_buffer(RING_LEN, sizeof(complex));
+	double rm, rs;
+
+	rm = ring_single(m);
+	rs = ring_single(s);
+	printf("ring\tsingle item write/peek/purge: mutex %.1f Mops/s, spsc %.1f Mops/s (%.1fx)\n",
+	   rm / 1e6, rs / 1e6, rs / rm);
+
+	m->flush();
+	s->flush();
+	rm = ring_threads(m);
+	rs = ring_threads(s);
+	printf("ring\t%u item blocks between threads: mutex %.0f Mitems/s, spsc %.0f Mitems/s (%.1fx)\n",
+	   RING_BLOCK, rm / 1e6, rs / 1e6, rs / rm);
+
+	delete m;
+	delete s;
+}
+
+
+/*
+ * lms
+ */
+static const unsigned int	LMS_LEN		= 1 << 20;
+static const unsigned int	LMS_ROUNDS	= 4;
+static const unsigned int	LMS_KERNELS_MAX	= 8;
+
+
+static void bench_lms() {
+
+	const lms_kernels *k[LMS_KERNELS_MAX];
+	unsigned int n_k, i, r, seed = 1;
+	complex *s;
+	float *e;
+	fcch_detector *l;
+	double t, scalar = 0.0;
+
+	s = new complex[LMS_LEN];
+	e = new float[LMS_LEN];
+	for(i = 0; i < LMS_LEN; i++) {
+		s[i] = complex(noise(&seed), noise(&seed));
+		s[i] *= 0.1f;
+		s[i] += complex(cosf(M_PI / 2 * i), sinf(M_PI / 2 * i));
+	}
+
+	n_k = lms_kernels_all(k, LMS_KERNELS_MAX);
+	for(i = 0; i < n_k; i++) {
+		l = new fcch_detector(GSM_RATE);
+		l->set_kernels(k[i]);
+		t = now();
+		for(r = 0; r < LMS_ROUNDS; r++)
+			l->next_norm_errors(s, LMS_LEN, e);
+		t = (double)LMS_ROUNDS * LMS_LEN / (now() - t);
+		if(!i)
+			scalar = t;
+		printf("lms	%-8s %6.1f Msamples/s (%.1fx scalar)%s\n", k[i]->name,
+		   t / 1e6, t / scalar,
+		   (k[i] == lms_kernels_select(l->filter_len()))? ", selected" : "");
+		delete l;
+	}
+
+	delete[] s;
+	delete[] e;
+}
+
+
+/*
+ * startup
+ */
+static const unsigned int	STARTUP_COUNT	= 200;
+
+
+static void bench_startup() {
+
+	unsigned int i;
+	fcch_detector *l;
+	double t, first;
+
+	t = now();
+	l = new fcch_detector(GSM_RATE);
+	first = now() - t;
+	delete l;
+
+	t = now();
+	for(i = 0; i < STARTUP_COUNT; i++) {
+		l = new fcch_detector(GSM_RATE);
+		delete l;
+	}
+	t = (now() - t) / STARTUP_COUNT;
+
+	printf("startup\tfirst fcch_detector %.3f ms, later ones %.3f ms each\n",
+	   first * 1e3, t * 1e3);
+}
+
+
+/*
+ * estimator
+ */
+static const unsigned int	EST_LEN		= 148;
+static const unsigned int	EST_FFT_SIZE	= 1024;
+static const unsigned int	EST_TRIALS	= 300;
+static const float		EST_OFFSET_MAX	= 20e3;
+
+
+static inline float sinc(const float x) {
+
+	if((x <= -0.0001) || (0.0001 <= x))
+		return sinf(x) / x;
+	return 1.0;
+}
+
+
+static inline complex interpolate_point(const complex *s, const unsigned int s_len, const float s_i) {
+
+	static const unsigned int filter_len = 21;
+
+	int start, end, i;
+	unsigned int d;
+	complex point;
+
+	d = (filter_len - 1) / 2;
+	start = (int)(floor(s_i) - d);
+	end = (int)(floor(s_i) + d + 1);
+	if(start < 0)
+		start = 0;
+	if(end > (int)(s_len - 1))
+		end = s_len - 1;
+	for(point = 0.0, i = start; i <= end; i++)
+		point += s[i] * sinc(M_PI * (i - s_i));
+	return point;
+}
+
+
+/*
+ * The peak search fcch_detector used before the zoomed estimate, kept here
+ * only to compare against.  Returns the peak in bins.
+ */
+static float sinc_search(const complex *s, const unsigned int s_len) {
+
+	unsigned int i;
+	float max = -1.0, max_i = -1.0, sample_power, early_i, late_i, incr;
+	complex early_p, late_p;
+
+	for(i = 0; i < s_len; i++) {
+		sample_power = norm(s[i]);
+		if(sample_power > max) {
+			max = sample_power;
+			max_i = i;
+		}
+	}
+	early_i = (1 <= max_i)? (max_i - 1) : 0;
+	late_i = (max_i + 1 < s_len)? (max_i + 1) : s_len - 1;
+
+	incr = 0.5;
+	while(incr > 1.0 / 1024.0) {
+		early_p = interpolate_point(s, s_len, early_i);
+		late_p = interpolate_point(s, s_len, late_i);
+		if(norm(early_p) < norm(late_p))
+			early_i += incr;
+		else if(norm(early_p) > norm(late_p))
+			early_i -= incr;
+		else
+			break;
+		incr /= 2.0;
+		late_i = early_i + 2.0;
+	}
+	return early_i + 1.0;
+}
+
+
+static void bench_estimator() {
+
+	static const float snr_db[] = {INFINITY, 20.0, 10.0, 3.0};
+	static const char *name[3] = {"fft zoom", "phase", "sinc search"};
+
+	unsigned int i, j, m, t, seed = 1;
+	complex s[EST_LEN], *fft;
+	float f, est = 0.0, pm, var, sigma;
+	double err2[3], took[3], t0, t_fft;
+	fftwf_plan plan;
+	fcch_detector *l;
+
+	l = new fcch_detector(GSM_RATE);
+	fft = fft_alloc(EST_FFT_SIZE);
+	plan = fft_plan(EST_FFT_SIZE, 1, FFTW_FORWARD, FFTW_MEASURE);
+
+	// the fft and sinc estimates include one transform, this is its share
+	for(i = 0; i < EST_FFT_SIZE; i++)
+		fft[i] = 0.0;
+	t0 = now();
+	for(t = 0; t < EST_TRIALS; t++)
+		fft_execute(plan, fft);
+	t_fft = (now() - t0) / EST_TRIALS;
+	printf("estimator\t%u point fft %.2f us\n", EST_FFT_SIZE, t_fft * 1e6);
+
+	for(j = 0; j < sizeof(snr_db) / sizeof(snr_db[0]); j++) {
+		sigma = isinf(snr_db[j])? 0.0 : sqrtf(0.5f * powf(10.0, -snr_db[j] / 10.0));
+		for(m = 0; m < 3; m++)
+			err2[m] = took[m] = 0.0;
+
+		for(t = 0; t < EST_TRIALS; t++) {
+			f = GSM_RATE / 4 + EST_OFFSET_MAX * noise(&seed);
+			for(i = 0; i < EST_LEN; i++) {
+				s[i] = complex(cos(2.0 * M_PI * f * i / GSM_RATE),
+				   sin(2.0 * M_PI * f * i / GSM_RATE));
+				s[i] += complex(sigma * noise(&seed) * 1.732f,
+				   sigma * noise(&seed) * 1.732f);
+			}
+
+			for(m = 0; m < 3; m++) {
+				t0 = now();
+				if(m == 0)
+					est = l->freq_detect(s, EST_LEN, &pm);
+				else if(m == 1)
+					est = l->phase_detect(s, EST_LEN, &pm, &var);
+				else {
+					for(i = 0; i < EST_FFT_SIZE; i++)
+						fft[i] = (i < EST_LEN)? s[i] : 0.0;
+					fft_execute(plan, fft);
+					est = sinc_search(fft, EST_FFT_SIZE) * GSM_RATE / EST_FFT_SIZE;
+				}
+				took[m] += now() - t0;
+				err2[m] += (est - f) * (est - f);
+			}
+		}
+
+		for(m = 0; m < 3; m++) {
+			printf("estimator\t%4.0f dB  %-12s rms error %8.3f Hz  %6.2f us/estimate\n",
+			   snr_db[j], name[m], sqrt(err2[m] / EST_TRIALS),
+			   took[m] / EST_TRIALS * 1e6);
+		}
+	}
+
+	fft_free(fft);
+	delete l;
+}
+
+
+/*
+ * lime
+ */
+static const unsigned int	LIME_WARMUP	= 20;
+static const unsigned int	LIME_FILLS	= 200;
+static const unsigned int	LIME_FILL_LEN	= 16384;
+
+
+static void bench_lime() {
+
+	lime_source *u;
+	unsigned int i, overruns, total = 0;
+	unsigned long before = 0;
+
+	try {
+		u = new lime_source(GSM_RATE, 30.72e6, -1.0);
+	} catch(std::exception &e) {
+		fprintf(stderr, "lime\terror: %s\n", e.what());
+		return;
+	}
+	if(u->open(0) == -1) {
+		fprintf(stderr, "lime\terror: no LimeSDR\n");
+		delete u;
+		return;
+	}
+
+	u->start();
+	if(u->tune(940e6) == -1) {
+		fprintf(stderr, "lime\terror: tune\n");
+		delete u;
+		return;
+	}
+
+	for(i = 0; i < LIME_WARMUP + LIME_FILLS; i++) {
+		if(i == LIME_WARMUP)
+			before = g_allocs;
+		if(u->fill(LIME_FILL_LEN, &overruns))
+			break;
+		total += overruns;
+		u->get_buffer()->purge(LIME_FILL_LEN);
+	}
+	printf("lime\t%lu heap allocations over %u fills of %u samples (%u overruns)\n",
+	   g_allocs - before, i - LIME_WARMUP, LIME_FILL_LEN, total);
+
+	u->stop();
+	delete u;
+}
+
+
+struct section {
+	const char	*name;
+	void		(*run)();
+	int		radio;
+};
+
+static const section sections[] = {
+	{"ring",	bench_ring,	0},
+	{"lms",		bench_lms,	0},
+	{"startup",	bench_startup,	0},
+	{"estimator",	bench_estimator,	0},
+	{"lime",	bench_lime,	1},
+};
+static const unsigned int n_sections = sizeof(sections) / sizeof(sections[0]);
+
+
+int main(int argc, char **argv) {
+
+	unsigned int i;
+	int a;
+
+	if(argc == 1) {
+		for(i = 0; i < n_sections; i++) {
+			if(!sections[i].radio)
+				sections[i].run();
+		}
+		return 0;
+	}
+
+	for(a = 1; a < argc; a++) {
+		for(i = 0; (i < n_sections) && strcmp(argv[a], sections[i].name); i++)
+			;
+		if(i == n_sections) {
+			fprintf(stderr, "usage: %s [", argv[0]);
+			for(i = 0; i < n_sections; i++)
+				fprintf(stderr, "%s%s", i? " | " : "", sections[i].name);
+			fprintf(stderr, "] ...\n");
+			return 1;
+		}
+		sections[i].run();
+	}
+
+	return 0;
+}
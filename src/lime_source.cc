@@ -34,10 +34,26 @@
 #include <math.h>
 #include <complex>
 #include <iostream>
+#include <stdexcept>
 #include <lime/LimeSuite.h>
 
 #include "lime_source.h"
 
+// Magic number - reference taken from running USRP B210
+static const unsigned int	SAMPLES_PER_PACKET	= 2040;
+
+// time constant of the DC offset estimate (s)
+static const double		DC_TAU			= 0.05;
+
+/*
+ * After a retune, samples are dropped until this long after the stream
+ * timestamp at which the LO write returned.  It covers the samples that were
+ * still in the device and in the USB transfers when the LO changed, and the
+ * LO and DC offset settling.
+ */
+static const double		TUNE_SETTLE		= 0.002;
+static const unsigned int	TUNE_SETTLE_MIN		= 4 * 1360;	// USB packets
+
 extern int g_verbosity;
 
 
@@ -49,22 +65,48 @@ lime_source::lime_source(double sample_rate,
 	m_fpga_master_clock_freq = fpga_master_clock_freq;
 	m_external_ref = external_ref;
 	m_sample_rate = 0.0;
-	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
+	m_serial[0] = 0;
+	m_cb = new spsc_circular_buffer(CB_LEN, sizeof(complex));
+	m_recv_samples_per_packet = SAMPLES_PER_PACKET;
+	if (posix_memalign(&m_drop_buf, getpagesize(), SAMPLES_PER_PACKET * sizeof(complex)) != 0) {
+		delete m_cb;
+		throw std::runtime_error("lime_source: posix_memalign");
+	}
+	m_fe = frontend_kernels_select();
+	m_stats = capture_stats();
+	m_dc_reset = true;
+	m_session = false;
+	m_active = false;
+	m_resync_ts = 0;
+	m_rx_running = false;
+	m_overruns = 0;
+	m_local_overruns = 0;
 
 	pthread_mutex_init(&m_u_mutex, 0);
+	pthread_mutex_init(&m_fill_mutex, 0);
+	pthread_cond_init(&m_fill_cond, 0);
 }
 
 
 lime_source::~lime_source() {
 
+	close_session();
 	delete m_cb;
+	free(m_drop_buf);
 	LMS_Close(m_dev);
+	pthread_cond_destroy(&m_fill_cond);
+	pthread_mutex_destroy(&m_fill_mutex);
 	pthread_mutex_destroy(&m_u_mutex);
 }
 
 void lime_source::tune_dac(uint16_t dacVal) {
 
-	if (LMS_VCTCXOWrite(m_dev, dacVal) != 0) {
+	int ret;
+
+	pthread_mutex_lock(&m_u_mutex);
+	ret = LMS_VCTCXOWrite(m_dev, dacVal);
+	pthread_mutex_unlock(&m_u_mutex);
+	if (ret != 0) {
 		fprintf(stderr, "Failed to set runtime VCTCXO DAC trim value\n");
 	}
 	fprintf(stderr, "VCTCXO DAC value set to: %f\n", get_board_dac());
@@ -73,43 +115,145 @@ void lime_source::tune_dac(uint16_t dacVal) {
 double lime_source::get_board_dac() {
 
 	double dac_value = 0.0;
-	if (LMS_ReadCustomBoardParam(m_dev, BOARD_PARAM_DAC, &dac_value, NULL) != 0) {
+	int ret;
+
+	pthread_mutex_lock(&m_u_mutex);
+	ret = LMS_ReadCustomBoardParam(m_dev, BOARD_PARAM_DAC, &dac_value, NULL);
+	pthread_mutex_unlock(&m_u_mutex);
+	if (ret != 0) {
 		fprintf(stderr, "Failed to read runtime VCTCXO DAC trim value\n");
 	}
 	return dac_value;
 }
 
 
-void lime_source::stop() {
+double lime_source::temperature() {
+
+	double temp = 0.0;
+	int ret;
 
 	pthread_mutex_lock(&m_u_mutex);
-	if(m_dev) {
+	ret = LMS_GetChipTemperature(m_dev, 0, &temp);
+	pthread_mutex_unlock(&m_u_mutex);
+	if (ret != 0) {
+		fprintf(stderr, "Failed to read chip temperature\n");
+	}
+	return temp;
+}
+
+
+/*
+ * Serial number of the opened device, or an empty string if the device info
+ * did not include one.
+ */
+const char *lime_source::serial() {
+
+	return m_serial;
+}
+
+
+/*
+ * The stream session outlives start() and stop(): the stream is set up and
+ * the receive thread started once, and kept running across measurements,
+ * retunes and DAC writes.  Only a sample rate change, which the stream cannot
+ * follow, or the destructor ends it.  Between stop() and start() the receive
+ * thread keeps draining the device but throws the packets away.
+ */
+int lime_source::open_session() {
+
+	pthread_mutex_lock(&m_u_mutex);
+	// TODO: Perform calibration if possible
+
+	/* configure Streams */
+	m_rx_stream = {};
+	m_rx_stream.isTx = false;
+	m_rx_stream.channel = 0;
+	m_rx_stream.fifoSize = 1024 * 1024;
+	m_rx_stream.throughputVsLatency = 0.3;
+	m_rx_stream.dataFmt = lms_stream_t::LMS_FMT_I16;
+
+	if (LMS_SetupStream(m_dev, &m_rx_stream) != 0) {
+		pthread_mutex_unlock(&m_u_mutex);
+		fprintf(stderr, "LMS_SetupStream: Failed to set up RX stream\n");
+		return -1;
+	}
+	LMS_StartStream(&m_rx_stream);
+	pthread_mutex_unlock(&m_u_mutex);
+
+	m_resync_ts = 0;
+	m_rx_running = true;
+	if (pthread_create(&m_rx_thread, 0, rx_thread, this) != 0) {
+		fprintf(stderr, "error: failed to start receive thread\n");
+		m_rx_running = false;
+		pthread_mutex_lock(&m_u_mutex);
 		LMS_StopStream(&m_rx_stream);
 		LMS_DestroyStream(m_dev, &m_rx_stream);
+		pthread_mutex_unlock(&m_u_mutex);
+		return -1;
 	}
-	pthread_mutex_unlock(&m_u_mutex);
+	m_session = true;
+
+	return 0;
 }
 
 
-void lime_source::start() {
+void lime_source::close_session() {
+
+	if (!m_session)
+		return;
+
+	m_active = false;
+	m_rx_running = false;
+	pthread_join(m_rx_thread, 0);
 
 	pthread_mutex_lock(&m_u_mutex);
-	if(m_dev) {
-		// TODO: Perform calibration if possible
+	LMS_StopStream(&m_rx_stream);
+	LMS_DestroyStream(m_dev, &m_rx_stream);
+	pthread_mutex_unlock(&m_u_mutex);
+	m_session = false;
+}
 
-		/* configure Streams */
-		m_rx_stream = {};
-		m_rx_stream.isTx = false;
-		m_rx_stream.channel = 0;
-		m_rx_stream.fifoSize = 1024 * 1024;
-		m_rx_stream.throughputVsLatency = 0.3;
-		m_rx_stream.dataFmt = lms_stream_t::LMS_FMT_I16;
 
-		LMS_SetupStream(m_dev, &m_rx_stream);
+/*
+ * Drop everything sampled before now.  The packets still in flight are
+ * recognized by their timestamps as they arrive, so the stream does not have
+ * to be rebuilt to get rid of them.
+ */
+void lime_source::resync() {
 
-		LMS_StartStream(&m_rx_stream);
-	}
+	lms_stream_status_t status;
+	uint64_t now = 0;
+
+	pthread_mutex_lock(&m_u_mutex);
+	if (LMS_GetStreamStatus(&m_rx_stream, &status) == 0)
+		now = status.timestamp;
 	pthread_mutex_unlock(&m_u_mutex);
+
+	discard(now);
+}
+
+
+void lime_source::stop() {
+
+	m_active = false;
+}
+
+
+void lime_source::start() {
+
+	if (!m_dev)
+		return;
+
+	// a session whose receive thread has failed is rebuilt
+	if (m_session && !m_rx_running)
+		close_session();
+
+	if (m_session)
+		resync();
+	else if (open_session() != 0)
+		return;
+
+	m_active = true;
 }
 
 
@@ -118,10 +262,87 @@ double lime_source::sample_rate() {
 	return m_sample_rate;
 }
 
-int lime_source::tune(double freq) {
+/*
+ * Make m_cb big enough for CB_TIME seconds at the sample rate, so a wideband
+ * capture leaves room for the receive thread while it is processed.  Only
+ * while there is no session.
+ */
+int lime_source::resize_buffer() {
+
+	unsigned int len = CB_LEN;
+	circular_buffer *cb;
+
+	if (m_sample_rate * CB_TIME > len)
+		len = (unsigned int)(m_sample_rate * CB_TIME);
+	if ((len <= m_cb->buf_len()) && (m_cb->buf_len() / 2 < len))
+		return 0;
+
+	try {
+		cb = new spsc_circular_buffer(len, sizeof(complex));
+	} catch (std::exception &e) {
+		fprintf(stderr, "error: lime_source: %s\n", e.what());
+		return -1;
+	}
+	delete m_cb;
+	m_cb = cb;
+
+	return 0;
+}
+
+
+/*
+ * Change the sample rate.  The stream must be stopped.
+ */
+int lime_source::set_sample_rate(double sample_rate) {
+
+	double sr_rf;
+	size_t oversample;
+	int ret = 0;
+
+	// the next start() sets up a stream at the new rate
+	close_session();
+
+	pthread_mutex_lock(&m_u_mutex);
+
+	// Decimation is set to 32 - refer LMSDevice.cpp in osmo-trx.  Wideband
+	// rates can't be oversampled that much, so let LimeSuite choose.
+	oversample = (sample_rate < WIDEBAND_RATE)? 32 : 0;
+	if (LMS_SetSampleRate(m_dev, sample_rate, oversample) != 0) {
+		fprintf(stderr, "LMS_SetSampleRate: Failed to set RX sampling rate\n");
+		ret = -1;
+	} else if (LMS_GetSampleRate(m_dev, LMS_CH_RX, 0, &m_sample_rate, &sr_rf) != 0) {
+		fprintf(stderr, "LMS_GetSampleRate: Failed to get RX sampling rate\n");
+		ret = -1;
+	} else if ((sample_rate >= WIDEBAND_RATE) &&
+	   (LMS_SetLPFBW(m_dev, LMS_CH_RX, 0, sample_rate) != 0)) {
+		fprintf(stderr, "LMS_SetLPFBW: Failed to set RX bandwidth\n");
+		ret = -1;
+	}
+
+	pthread_mutex_unlock(&m_u_mutex);
+
+	// the receive thread is down, so the ring can be swapped
+	if ((ret == 0) && (resize_buffer() != 0))
+		ret = -1;
+
+	m_dc_reset = true;
+	if (ret == 0)
+		fprintf(stderr, "Sample rate: %f\n", m_sample_rate);
+
+	return ret;
+}
+
+
+/*
+ * Empties the buffer and has the receive thread drop every sample up to the
+ * returned timestamp ts, from which on the new frequency has settled.
+ */
+int lime_source::tune(double freq, unsigned long long *ts) {
 
 	double actual_freq = 0.0;
 	int ret = 0;
+	uint64_t settled = 0, settle;
+	lms_stream_status_t status;
 
 	pthread_mutex_lock(&m_u_mutex);
 	if (LMS_SetLOFrequency(m_dev, LMS_CH_RX, 0, freq) != 0) {
@@ -133,8 +354,22 @@ int lime_source::tune(double freq) {
 		fprintf(stderr, "LMS_GetLOFrequency: Failed to get RX LO frequency\n");
 		ret = -1;
 	}
+
+	// without a stream, the next one starts after the LO write
+	if (m_session && (LMS_GetStreamStatus(&m_rx_stream, &status) == 0)) {
+		settle = (uint64_t)(TUNE_SETTLE * m_sample_rate);
+		if (settle < TUNE_SETTLE_MIN)
+			settle = TUNE_SETTLE_MIN;
+		settled = status.timestamp + settle;
+	}
 	pthread_mutex_unlock(&m_u_mutex);
 
+	// the LO leakage moves with the LO
+	m_dc_reset = true;
+	discard(settled);
+	if (ts)
+		*ts = settled;
+
 	return ret;
 }
 
@@ -178,13 +413,11 @@ void print_range(lms_range_t *range) {
  */
 int lime_source::open(char *subdev) {
 
-	// Magic number - reference taken from running USRP B210
-	#define SAMPLES_PER_PACKET 2040
-
 	unsigned int i, n, s_len;
 	//should be large enough to hold all detected devices
 	lms_info_str_t info_list[8];
 	lms_range_t range_sr;
+	const char *serial;
 
 	if ((n = LMS_GetDeviceList(info_list)) < 0)
 		fprintf(stderr, "LMS_GetDeviceList(NULL) failed\n");
@@ -195,6 +428,14 @@ int lime_source::open(char *subdev) {
 	// TODO: Handle case of multiple LimeSDRs
 
 	fprintf(stderr, "Device info: %s\n", info_list[0]);
+	if ((serial = strstr(info_list[0], "serial="))) {
+		serial += strlen("serial=");
+		s_len = strcspn(serial, ", ");
+		if (s_len >= sizeof(m_serial))
+			s_len = sizeof(m_serial) - 1;
+		memcpy(m_serial, serial, s_len);
+		m_serial[s_len] = 0;
+	}
 	//open the first device
 	if (LMS_Open(&m_dev, info_list[0], NULL) != 0) {
 		LMS_Close(m_dev);
@@ -240,27 +481,14 @@ int lime_source::open(char *subdev) {
 		return -1;
 	print_range(&range_sr);
 
-	// Decimation is set to 32 - refer LMSDevice.cpp in osmo-trx
-	if (LMS_SetSampleRate(m_dev, m_desired_sample_rate, 32) != 0) {
-		fprintf(stderr, "LMS_SetSampleRate: Failed to set RX sampling rate\n");
+	if (set_sample_rate(m_desired_sample_rate) != 0)
 		return -1;
-	}
-
-	double sr_rf;
-	if (LMS_GetSampleRate(m_dev, LMS_CH_RX, 0, &m_sample_rate, &sr_rf) != 0) {
-		fprintf(stderr, "LMS_GetSampleRate: Failed to get RX sampling rate\n");
-		return -1;
-	}
-
-	fprintf(stderr, "Sample rate: %f\n", m_sample_rate);
 
 	set_antenna("LNAH");
 
 	// RX gain to midpoint
 	set_gain((maxRxGain() + minRxGain())/2);
 
-	m_recv_samples_per_packet = SAMPLES_PER_PACKET;
-
 	return 0;
 }
 
@@ -274,78 +502,186 @@ double lime_source::minRxGain()
 	return 0.0;
 }
 
-std::string handle_rx_err(lms_stream_status_t *status, bool &overrun) {
+/*
+ * Returns a static message describing the stream status, or 0 if there is
+ * nothing to report.  Called for every packet, so it must not allocate.
+ */
+static const char *handle_rx_err(lms_stream_status_t *status, bool &overrun) {
 
 	overrun = false;
-	std::ostringstream ost("");
 
-	if (status->overrun == 0 && status->underrun == 0) {
-		// Do nothing
-	} else if (status->overrun > 0) {
+	if (status->overrun == 0 && status->underrun == 0)
+		return 0;
+	if (status->overrun > 0) {
 		overrun = true;
-		ost << "error: receive buffer is full (overrun)\n";
-	} else if (status->underrun > 0) {
-		ost << "error: receive buffer underrun\n";
-	} else {
-		ost << "error: unknown error\n";
+		return "error: receive buffer is full (overrun)\n";
 	}
+	if (status->underrun > 0)
+		return "error: receive buffer underrun\n";
+	return "error: unknown error\n";
+}
+
+
+void *lime_source::rx_thread(void *arg) {
 
-	return ost.str();
+	((lime_source *)arg)->rx_loop();
+	return 0;
 }
 
-int lime_source::fill(unsigned int num_samples, unsigned int *overrun) {
 
-	int16_t *ubuf = new int16_t[m_recv_samples_per_packet * 2];
-	int num_smpls, expect_smpls;
-	unsigned int i, j, space, overrun_cnt;
+/*
+ * Runs between start() and stop(), draining the device into m_cb so the
+ * hardware FIFO never waits on the DSP.  Each packet is received as I16 into
+ * the upper half of the ring space it will occupy and expanded in place, so
+ * no packet is copied and nothing is allocated per packet.  A packet that
+ * does not fit in the ring goes to m_drop_buf instead and is counted as an
+ * overrun, since the samples in the ring are then no longer contiguous in
+ * time.
+ *
+ * The expansion is the front end pass: it also removes the DC offset and
+ * adds the packet to m_stats.  The DC estimate is the mean of the packets
+ * since the last tune, until that spans DC_TAU, and then a moving average
+ * over DC_TAU.  A packet is committed to the ring and to m_stats under
+ * m_fill_mutex, so that flush() discards both together.
+ *
+ * Until start() nothing is kept, and after a resync() or tune() nothing
+ * sampled before m_resync_ts is.  A packet that straddles m_resync_ts keeps
+ * its tail, and one that was being converted when m_resync_ts moved is
+ * dropped.
+ */
+void lime_source::rx_loop() {
+
+	unsigned int n = m_recv_samples_per_packet, space, skip, len;
+	uint64_t resync_ts;
+	int num_smpls;
+	bool overrun_pkt = false, active, full, keep, status_ok;
 	complex *c;
-	bool overrun_pkt = false;
+	int16_t *u;
+	float dc[2] = {0, 0}, peak;
+	double sum[2], energy, dc_n = 0, dc_max = DC_TAU * m_sample_rate;
+	lms_stream_status_t status;
 	lms_stream_meta_t rx_metadata = {};
 	rx_metadata.flushPartialPacket = false;
 	rx_metadata.waitForTimestamp = false;
 
-	overrun_cnt = 0;
+	while (m_rx_running) {
+		// the ring is mirrored, so all free space is contiguous
+		active = m_active;
+		c = (complex *)m_cb->poke(&space);
+		full = active && (space < n);
+		if (!active || full)
+			c = (complex *)m_drop_buf;
+		u = (int16_t *)(c + n) - 2 * n;
 
-	while ((m_cb->data_available() < num_samples)
-			&& m_cb->space_available() > 0) {
+		// tune() and resync() use the device under the same lock
 		pthread_mutex_lock(&m_u_mutex);
-		num_smpls = LMS_RecvStream(&m_rx_stream, ubuf, m_recv_samples_per_packet, &rx_metadata, 100);
+		num_smpls = LMS_RecvStream(&m_rx_stream, u, n, &rx_metadata, 100);
+		status_ok = (num_smpls >= 0) &&
+		   (LMS_GetStreamStatus(&m_rx_stream, &status) == 0);
 		pthread_mutex_unlock(&m_u_mutex);
+		if (num_smpls < 0) {
+			fprintf(stderr, "LMS_RecvStream: Failed to receive samples\n");
+			break;
+		}
 
-		lms_stream_status_t status;
-		if (LMS_GetStreamStatus(&m_rx_stream, &status) != 0) {
+		if (!status_ok) {
 			fprintf(stderr, "Rx LMS_GetStreamStatus failed\n");
+			status = {};
 		}
 
-		std::string err_str = handle_rx_err(&status, overrun_pkt);
-		if (overrun_pkt) {
-			overrun_cnt++;
+		handle_rx_err(&status, overrun_pkt);
+		if (overrun_pkt && active) {
+			m_overruns++;
 		}
 
-		// write complex<short> input to complex<float> output
-		c = (complex *)m_cb->poke(&space);
+		// sampled before the last resync or retune settled
+		resync_ts = m_resync_ts;
+		skip = 0;
+		if (rx_metadata.timestamp < resync_ts) {
+			if (rx_metadata.timestamp + num_smpls <= resync_ts)
+				active = false;
+			else
+				skip = resync_ts - rx_metadata.timestamp;
+		}
+		len = (num_smpls > 0)? num_smpls - skip : 0;
+		keep = active && !full && (len > 0);
+
+		if (m_dc_reset.exchange(false)) {
+			dc[0] = dc[1] = 0;
+			dc_n = 0;
+		}
 
-		// set space to number of complex items to copy
-		if(space > m_recv_samples_per_packet)
-			space = m_recv_samples_per_packet;
+		sum[0] = sum[1] = energy = 0;
+		peak = 0;
+		if (full && (num_smpls > 0)) {
+			m_local_overruns++;
+			m_overruns++;
+		}
+		if (keep)
+			m_fe->convert_i16((float *)c, u + 2 * skip, len, dc, sum, &energy, &peak);
+
+		pthread_mutex_lock(&m_fill_mutex);
+		if (keep && (m_resync_ts != resync_ts))
+			keep = false;
+		if (keep) {
+			m_cb->wrote(len);
+			m_stats.count += len;
+			m_stats.energy += energy;
+			if (peak > m_stats.peak)
+				m_stats.peak = peak;
+			m_stats.dc = complex(dc[0], dc[1]);
+		}
+		pthread_cond_broadcast(&m_fill_cond);
+		pthread_mutex_unlock(&m_fill_mutex);
+
+		// sum is of the samples after the DC was removed
+		if (keep) {
+			dc_n += len;
+			if (dc_n > dc_max)
+				dc_n = dc_max;
+			dc[0] += sum[0] / dc_n;
+			dc[1] += sum[1] / dc_n;
+		}
+	}
 
-		// write data
-		for(i = 0, j = 0; i < space; i += 1, j += 2)
-			c[i] = complex(ubuf[j], ubuf[j + 1]);
+	// wake anyone still waiting in fill()
+	pthread_mutex_lock(&m_fill_mutex);
+	m_rx_running = false;
+	pthread_cond_broadcast(&m_fill_cond);
+	pthread_mutex_unlock(&m_fill_mutex);
+}
+
+
+/*
+ * Wait until at least num_samples are in the buffer.  overrun is set to the
+ * number of overruns since the previous call.
+ */
+int lime_source::fill(unsigned int num_samples, unsigned int *overrun) {
 
-		// update cb
-		m_cb->wrote(i);
+	int ret = 0;
+
+	if (num_samples > m_cb->buf_len())
+		num_samples = m_cb->buf_len();
+
+	pthread_mutex_lock(&m_fill_mutex);
+	while ((m_cb->data_available() < num_samples) && m_rx_running && m_active)
+		pthread_cond_wait(&m_fill_cond, &m_fill_mutex);
+	if (m_cb->data_available() < num_samples) {
+		fprintf(stderr, "error: receive stream is not started\n");
+		ret = -1;
 	}
+	pthread_mutex_unlock(&m_fill_mutex);
 
-	// if the cb is full, we left behind data from the usb packet
-	if(m_cb->space_available() == 0) {
+	// if the cb was full, we left behind data from the usb packets
+	if (m_local_overruns.exchange(0)) {
 		fprintf(stderr, "warning: local overrun\n");
 	}
 
+	unsigned int overrun_cnt = m_overruns.exchange(0);
 	if (overrun)
 		*overrun = overrun_cnt;
 
-	return 0;
+	return ret;
 }
 
 
@@ -366,7 +702,8 @@ int lime_source::read(complex *buf, unsigned int num_samples, unsigned int *samp
 
 
 /*
- * Don't hold a lock on this and use the lime at the same time.
+ * The receive thread is the buffer's only producer, so the thread calling
+ * fill() must be its only consumer.
  */
 circular_buffer *lime_source::get_buffer() {
 
@@ -374,11 +711,41 @@ circular_buffer *lime_source::get_buffer() {
 }
 
 
-int lime_source::flush(unsigned int flush_count) {
+/*
+ * Statistics of the samples received since the last flush().  The peak is
+ * kept squared until here.
+ */
+void lime_source::get_stats(capture_stats *s) {
+
+	pthread_mutex_lock(&m_fill_mutex);
+	*s = m_stats;
+	pthread_mutex_unlock(&m_fill_mutex);
+	s->peak = sqrtf(s->peak);
+}
 
+
+/*
+ * Empty the buffer, the statistics and the overrun counts, and drop the
+ * samples before until as they arrive.
+ */
+void lime_source::discard(uint64_t until) {
+
+	pthread_mutex_lock(&m_fill_mutex);
+	if (until > m_resync_ts)
+		m_resync_ts = until;
 	m_cb->flush();
+	m_stats = capture_stats();
+	m_overruns = 0;
+	m_local_overruns = 0;
+	pthread_mutex_unlock(&m_fill_mutex);
+}
+
+
+int lime_source::flush(unsigned int flush_count) {
+
+	discard(0);
 	fill(flush_count, 0);
-	m_cb->flush();
+	discard(0);
 
 	return 0;
 }
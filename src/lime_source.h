@@ -27,13 +27,17 @@
 
 #include "config.h"
 
+#include <atomic>
+#include <pthread.h>
 #include <lime/LimeSuite.h>
 
 #include "complex.h"
 #include "circular_buffer.h"
+#include "radio_source.h"
+#include "simd_kernels.h"
 
 
-class lime_source {
+class lime_source : public radio_source {
 public:
 	lime_source(double sample_rate,
 			double fpga_master_clock_freq = 0.0,
@@ -47,7 +51,7 @@ public:
 		unsigned int *samples_read);
 
 	int fill(unsigned int num_samples, unsigned int *overrun);
-	int tune(double freq);
+	int tune(double freq, unsigned long long *ts = 0);
 	void set_antenna(const std::string antenna);
 	bool set_gain(double gain);
 	void start();
@@ -57,11 +61,23 @@ public:
 	int flush(unsigned int flush_count = FLUSH_COUNT);
 	void tune_dac(uint16_t dacVal);
 	double get_board_dac();
+	double temperature();
+	const char *serial();
 	circular_buffer *get_buffer();
+	void get_stats(capture_stats *s);
 
 	double sample_rate();
+	int set_sample_rate(double sample_rate);
 
 private:
+	static void *rx_thread(void *arg);
+	void rx_loop();
+	int open_session();
+	void close_session();
+	void resync();
+	void discard(uint64_t until);
+	int resize_buffer();
+
 	lms_device_t        *m_dev;
 	lms_stream_t		m_rx_stream;
 
@@ -70,15 +86,51 @@ private:
 	double				m_external_ref;
 	unsigned int        m_recv_samples_per_packet;
 	double				m_fpga_master_clock_freq;
+	char				m_serial[64];
 
 	circular_buffer		*m_cb;
 
+	/*
+	 * Page-aligned scratch for one packet, used by the receive thread when
+	 * the ring is too full to take it.
+	 */
+	void				*m_drop_buf;
+
+	const frontend_kernels	*m_fe;
+
 	/*
 	 * This mutex protects access to the lime
 	 */
 	pthread_mutex_t		m_u_mutex;
 
-	static const unsigned int	FLUSH_COUNT	= 10;
+	/*
+	 * While the session is up, m_rx_thread receives every packet and,
+	 * between start() and stop(), puts those sampled since m_resync_ts
+	 * into m_cb and signals m_fill_cond.  fill() only waits for the data.
+	 */
+	pthread_t			m_rx_thread;
+	bool				m_session;
+	std::atomic<bool>	m_rx_running,
+				m_active;
+	std::atomic<uint64_t>	m_resync_ts;
+	std::atomic<unsigned int>	m_overruns,
+					m_local_overruns;
+	pthread_mutex_t		m_fill_mutex;
+	pthread_cond_t		m_fill_cond;
+
+	/*
+	 * Front end statistics since the last flush(), under m_fill_mutex, and
+	 * a request from tune() to restart the DC estimate.
+	 */
+	capture_stats		m_stats;
+	std::atomic<bool>	m_dc_reset;
+
+	/*
+	 * m_cb holds at least CB_LEN samples, or CB_TIME seconds at the
+	 * sample rate, which is several wideband captures.
+	 */
+	static constexpr double		WIDEBAND_RATE	= 1.5e6;
 	static const unsigned int	CB_LEN		= (1 << 20);
+	static constexpr double		CB_TIME		= 0.25;
 	static const int			NCHAN		= 1;
 };
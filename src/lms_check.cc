@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * lms_check
+ *
+ *	Checks that fcch_detector::next_norm_errors(), which runs the LMS
+ *	filter straight over a block, gives bit for bit the same error ratios
+ *	as the per-sample next_norm_error() path through m_x_cb, with every
+ *	kernel set from lms_kernels_all().  The scalar kernels must also give
+ *	bit for bit the error ratios of reference_errors(), a copy of the
+ *	original std::complex filter.  The other kernel sets are compared with
+ *	it only to within ISA_TOLERANCE, since FMA and the order of the sums
+ *	change the rounding.
+ *
+ *	Exits non-zero on any mismatch, for make check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fcch_detector.h"
+#include "simd_kernels.h"
+
+static const double		GSM_RATE	= 1625000.0 / 6.0;
+static const unsigned int	CHECK_LEN	= 5 * 1250 * 8;	// 5 frames
+static const unsigned int	KERNELS_MAX	= 8;
+static const float		ISA_TOLERANCE	= 1e-4;
+
+// the fcch_detector defaults
+static const unsigned int	REF_D		= 8;
+static const unsigned int	REF_W_LEN	= 17;
+static const float		REF_P		= 1.0 / 32.0;
+static const float		REF_G		= 1.0 / 12.5;
+
+int g_debug = 0;
+
+
+/*
+ * Noise with an FCCH-like tone in the first burst of every frame, so that the
+ * filter both converges and loses lock.
+ */
+static void make_signal(complex *s, unsigned int len) {
+
+	unsigned int i, seed = 1;
+	float re, im;
+
+	for(i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		re = (float)((seed >> 16) & 0x7fff) / 0x4000 - 1.0;
+		seed = seed * 1103515245 + 12345;
+		im = (float)((seed >> 16) & 0x7fff) / 0x4000 - 1.0;
+		s[i] = complex(re, im) * 0.1f;
+		if(i % 1250 < 148)
+			s[i] += complex(cosf(M_PI / 2 * i), sinf(M_PI / 2 * i));
+	}
+}
+
+
+/*
+ * The per-sample filter as it was before the taps were split into real and
+ * imaginary arrays, run over all of x.  Kept as written, std::complex and
+ * all, since the point is to round exactly as it did.
+ */
+static unsigned int reference_errors(const complex *x, unsigned int x_len, float *error) {
+
+	unsigned int i, n, t, e_len = 0;
+	float E, m_G = REF_G, m_p = REF_P, m_e = 0.0;
+	complex m_w[REF_W_LEN], y, e;
+
+	for(i = 0; i < REF_W_LEN; i++)
+		m_w[i] = 0.0;
+
+	// n is "current" sample
+	n = REF_W_LEN - 1;
+
+	for(t = 0; t + n + REF_D < x_len; t++, x++) {
+		// update G
+		E = 0.0;
+		for(i = 0; i < REF_W_LEN; i++)
+			E += norm(x[i]);
+		if(m_G >= 2.0 / E)
+			m_G = 1.0 / E;
+
+		// calculate filtered value
+		y = 0.0;
+		for(i = 0; i < REF_W_LEN; i++)
+			y += std::conj(m_w[i]) * x[n - i];
+
+		// calculate error from desired signal
+		e = x[n + REF_D] - y;
+
+		// update filters with opposite gradient
+		for(i = 0; i < REF_W_LEN; i++)
+			m_w[i] += m_G * std::conj(e) * x[n - i];
+
+		// update error average power
+		E /= REF_W_LEN;
+		m_e = (1.0 - m_p) * m_e + m_p * norm(e);
+
+		// return error ratio
+		error[e_len++] = m_e / E;
+	}
+
+	return e_len;
+}
+
+
+static unsigned int per_sample(fcch_detector *l, const complex *s, unsigned int s_len, float *e) {
+
+	unsigned int i = 0, n = 0;
+
+	while(i < s_len) {
+		i += l->update(s + i, s_len - i);
+		while(!l->next_norm_error(e + n))
+			n++;
+	}
+	return n;
+}
+
+
+int main() {
+
+	const lms_kernels *k[KERNELS_MAX];
+	unsigned int n_k, i, j, n_one, n_block, n_ref, bad = 0;
+	complex *s;
+	float *one, *block, *ref, d, worst;
+	fcch_detector *l;
+
+	s = new complex[CHECK_LEN];
+	one = new float[CHECK_LEN];
+	block = new float[CHECK_LEN];
+	ref = new float[CHECK_LEN];
+	make_signal(s, CHECK_LEN);
+	n_ref = reference_errors(s, CHECK_LEN, ref);
+
+	n_k = lms_kernels_all(k, KERNELS_MAX);
+	for(i = 0; i < n_k; i++) {
+		l = new fcch_detector(GSM_RATE);
+		l->set_kernels(k[i]);
+		n_one = per_sample(l, s, CHECK_LEN, one);
+		delete l;
+
+		l = new fcch_detector(GSM_RATE);
+		l->set_kernels(k[i]);
+		n_block = l->next_norm_errors(s, CHECK_LEN, block);
+		delete l;
+
+		if((n_one != n_block) || memcmp(one, block, n_one * sizeof(float))) {
+			for(j = 0; (j < n_one) && (j < n_block) && (one[j] == block[j]); j++)
+				;
+			printf("%-8s FAIL: block path differs from per-sample path at %u of %u/%u\n",
+			   k[i]->name, j, n_one, n_block);
+			bad++;
+			continue;
+		}
+		if(n_block != n_ref) {
+			printf("%-8s FAIL: %u errors, the reference filter gives %u\n",
+			   k[i]->name, n_block, n_ref);
+			bad++;
+			continue;
+		}
+
+		// the scalar kernels are the original filter
+		if(!strcmp(k[i]->name, "scalar")) {
+			for(j = 0; (j < n_block) && !memcmp(block + j, ref + j, sizeof(float)); j++)
+				;
+			if(j < n_block) {
+				printf("%-8s FAIL: differs from the reference filter at %u of %u\n",
+				   k[i]->name, j, n_block);
+				bad++;
+			} else
+				printf("%-8s ok: %u errors bit for bit, the same as the reference filter\n",
+				   k[i]->name, n_block);
+			continue;
+		}
+
+		worst = 0.0;
+		for(j = 0; j < n_block; j++) {
+			d = fabsf(block[j] - ref[j]) / (fabsf(ref[j]) + 1e-6f);
+			if(d > worst)
+				worst = d;
+		}
+		printf("%-8s %s: %u errors bit for bit, max relative difference to the reference %.2g\n",
+		   k[i]->name, (worst > ISA_TOLERANCE)? "FAIL" : "ok", n_block, worst);
+		if(worst > ISA_TOLERANCE)
+			bad++;
+	}
+
+	delete[] s;
+	delete[] one;
+	delete[] block;
+	delete[] ref;
+
+	return bad? 1 : 0;
+}
@@ -25,93 +25,303 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "lime_source.h"
+#include "radio_source.h"
 #include "fcch_detector.h"
 #include "util.h"
+#include "worker_pool.h"
 #include <unistd.h>
+#include <math.h>
 
 
 static const unsigned int	AVG_COUNT	= 100;
-static const unsigned int	AVG_THRESHOLD	= (AVG_COUNT / 10);
+static const unsigned int	AVG_MIN		= 20;
+static const float		AVG_Z		= 1.96;	// 95% confidence
 static const float		OFFSET_MAX	= 40e3;
+static const unsigned int	MAX_BURSTS	= 8;	// per call to stream()
 
 extern int g_verbosity;
 
 
-int offset_detect(lime_source *u, float *off) {
+/*
+ * Insert o into the sorted array b of length len.
+ */
+static void insert_sorted(float *b, unsigned int len, float o) {
+
+	unsigned int i;
+
+	for(i = len; (i > 0) && (b[i - 1] > o); i--)
+		b[i] = b[i - 1];
+	b[i] = o;
+}
+
+
+/*
+ * Half-width of the confidence interval of the 10% trimmed mean of the sorted
+ * array b, using the winsorized variance.
+ */
+static float trimmed_ci(const float *b, unsigned int len) {
+
+	unsigned int i, g = len / 10;
+	double w, sum = 0.0, sum2 = 0.0, var;
+
+	if(len < 2 * g + 2)
+		return INFINITY;
+
+	for(i = 0; i < len; i++) {
+		w = b[(i < g)? g : ((i >= len - g)? len - g - 1 : i)];
+		sum += w;
+		sum2 += w * w;
+	}
+	var = (sum2 - sum * sum / len) / (len - 1);
+	if(var < 0.0)
+		var = 0.0;
+
+	return AVG_Z * sqrt(var) / ((1.0 - 2.0 * g / (double)len) * sqrt((double)len));
+}
+
+
+/*
+ * Add the offset of burst b to the sorted offsets, unless it fails the sanity
+ * check, and update the confidence interval ci.
+ */
+static void add_burst(const fcch_burst *b, float *offsets, unsigned int *count, float tolerance, float *ci) {
+
+	static const double GSM_RATE = 1625000.0 / 6.0;
+
+	float offset;
+
+	// FCH is a sine wave at GSM_RATE / 4
+	offset = b->offset - GSM_RATE / 4;
+
+	// sanity check offset
+	if(fabs(offset) >= OFFSET_MAX)
+		return;
+
+	insert_sorted(offsets, *count, offset);
+	*count += 1;
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "\toffset %3u: %.2f (+/- %.2f)\n", *count, offset, sqrtf(b->variance));
+	}
+
+	if((tolerance > 0.0) && (*count >= AVG_MIN))
+		*ci = trimmed_ci(offsets, *count);
+}
+
+
+struct window_jobs {
+	fcch_detector	**l;
+	complex		*w;
+	unsigned int	w_len,
+			*n;
+	fcch_burst	*b;
+};
+
+
+static void window_job(void *ctx, unsigned int worker, unsigned int job) {
+
+	window_jobs *j = (window_jobs *)ctx;
+
+	j->n[job] = j->l[worker]->scan_bursts(j->w + job * j->w_len, j->w_len,
+	   j->b + job * MAX_BURSTS, MAX_BURSTS, 0);
+}
+
+
+/*
+ * Copy n windows of w_len contiguous samples each into w.  A window that
+ * overruns is thrown away and captured again.  Returns the number of windows
+ * captured, fewer than n if the source ran out, or -1.
+ */
+static int capture(radio_source *u, complex *w, unsigned int w_len, unsigned int n, unsigned int *overruns) {
+
+	unsigned int k, new_overruns;
+	int r;
+	circular_buffer *cb = u->get_buffer();
+
+	for(k = 0; k < n; k++) {
+		do {
+			if((r = u->fill(w_len, &new_overruns)) < 0)
+				return -1;
+
+			// the last, partial window is not used
+			if(r > 0)
+				return k;
+			if(new_overruns) {
+				*overruns += new_overruns;
+				u->flush();
+			}
+		} while(new_overruns);
+		cb->read(w + k * w_len, w_len);
+	}
+
+	return n;
+}
+
+
+/*
+ * Measure the offset of the tuned BTS.  With a tolerance (Hz) of zero this
+ * always averages AVG_COUNT bursts, otherwise it stops as soon as the
+ * confidence interval of the trimmed mean is narrower than +/- tolerance,
+ * but never before AVG_MIN bursts.  estimator picks the fcch_detector
+ * frequency estimator (FCCH_EST_FFT or FCCH_EST_PHASE); a more precise one
+ * narrows the interval in fewer bursts.
+ *
+ * With one worker the samples are streamed through a single detector a frame
+ * at a time and every burst is used as soon as it ends.  With more, windows
+ * of 12 frames and 1 burst are captured a batch at a time, one window per
+ * worker, and each batch is scanned on the pool while the next is captured.
+ *
+ * If the source runs out of samples first, as a recording does, the result
+ * is made from the bursts found in what there was, provided that is at least
+ * AVG_MIN.
+ */
+int offset_detect(radio_source *u, float *off, float tolerance, int estimator, unsigned int workers) {
 
 	static const double GSM_RATE = 1625000.0 / 6.0;
 
 	unsigned int new_overruns = 0, overruns = 0;
-	int notfound = 0;
-	unsigned int s_len, b_len, consumed, count;
-	float offset = 0.0, min = 0.0, max = 0.0, avg_offset = 0.0,
-	   stddev = 0.0, sps, offsets[AVG_COUNT];
-	complex *cbuf;
-	fcch_detector *l;
+	int notfound = 0, ret = 0, r, ran_out, end = 0, have = 0, next;
+	unsigned int s_len, f_len, b_len, consumed, count, trim, n, i, k, w,
+	   since, cur, *found = 0;
+	float min = 0.0, max = 0.0, avg_offset = 0.0, stddev = 0.0, sps,
+	   ci = INFINITY, offsets[AVG_COUNT];
+	fcch_burst bursts[MAX_BURSTS];
+	complex *cbuf, *win[2] = {0, 0};
+	fcch_detector *l = 0;
 	circular_buffer *cb;
+	window_jobs jobs;
+	worker_pool *pool = 0;
 
-	l = new fcch_detector(u->sample_rate());
+	if(!workers)
+		workers = 1;
 
 	/*
-	 * We deliberately grab 12 frames and 1 burst.  We are guaranteed to
-	 * find at least one FCCH burst in this much data.
+	 * We are guaranteed to find at least one FCCH burst in 12 frames and 1
+	 * burst.
 	 */
 	sps = u->sample_rate() / GSM_RATE;
 	s_len = (unsigned int)ceil((12 * 8 * 156.25 + 156.25) * sps);
+	f_len = (unsigned int)ceil(8 * 156.25 * sps);
 	cb = u->get_buffer();
 
+	if(workers > 1) {
+		// one detector per worker, since each keeps its own filter state
+		jobs.l = new fcch_detector *[workers];
+		for(w = 0; w < workers; w++) {
+			jobs.l[w] = new fcch_detector(u->sample_rate());
+			jobs.l[w]->set_estimator(estimator);
+		}
+		jobs.w_len = s_len;
+		jobs.n = found = new unsigned int[workers];
+		jobs.b = new fcch_burst[workers * MAX_BURSTS];
+		win[0] = new complex[workers * s_len];
+		win[1] = new complex[workers * s_len];
+		pool = new worker_pool(workers, window_job, &jobs);
+	} else {
+		l = new fcch_detector(u->sample_rate());
+		l->set_estimator(estimator);
+	}
+
 	u->start();
-	u->flush();
 	count = 0;
-	while(count < AVG_COUNT) {
+	since = 0;
+	cur = 0;
+	if(pool && ((have = capture(u, win[cur], s_len, workers, &overruns)) < 0))
+		ret = -1;
+	while(!ret && !end && (count < AVG_COUNT) && !(ci < tolerance)) {
+
+		if(pool) {
+			// scan this batch while capturing the next one
+			jobs.w = win[cur];
+			pool->start(have);
+			if((next = capture(u, win[cur ^ 1], s_len, workers, &overruns)) < 0)
+				ret = -1;
+			pool->wait();
+
+			for(k = 0; k < (unsigned int)have; k++) {
+				if(!found[k])
+					++notfound;
+				for(i = 0; (i < found[k]) && (count < AVG_COUNT); i++)
+					add_burst(jobs.b + k * MAX_BURSTS + i, offsets, &count, tolerance, &ci);
+			}
+
+			// a short batch was the last one
+			if(have < (int)workers)
+				end = 1;
+			have = next;
+			cur ^= 1;
+			continue;
+		}
 
-		// ensure at least s_len contiguous samples are read from lime
+		// ensure at least f_len contiguous samples are read from the radio
 		do {
-			if(u->fill(s_len, &new_overruns)) {
-				return -1;
+			if((r = u->fill(f_len, &new_overruns)) < 0) {
+				ret = -1;
+				break;
 			}
+			ran_out = (r > 0);
 			if(new_overruns) {
 				overruns += new_overruns;
 				u->flush();
+
+				// the stream has a gap, start over
+				l->stream_reset();
+				since = 0;
 			}
 		} while(new_overruns);
+		if(ret)
+			break;
 
 		// get a pointer to the next samples
 		cbuf = (complex *)cb->peek(&b_len);
 
-		// search the buffer for a pure tone
-		if(l->scan(cbuf, b_len, &offset, &consumed)) {
-
-			// FCH is a sine wave at GSM_RATE / 4
-			offset = offset - GSM_RATE / 4;
-
-			// sanity check offset
-			if(fabs(offset) < OFFSET_MAX) {
-
-				offsets[count] = offset;
-				count += 1;
-
-				if(g_verbosity > 0) {
-					fprintf(stderr, "\toffset %3u: %.2f\n", count, offset);
-				}
-			}
-		} else {
+		// search the samples for pure tones, counting a miss each time
+		// s_len samples pass without one
+		n = l->stream(cbuf, b_len, bursts, MAX_BURSTS, &consumed);
+		since += consumed;
+		if(n)
+			since = 0;
+		else if(since >= s_len) {
 			++notfound;
+			since = 0;
 		}
+		for(i = 0; (i < n) && (count < AVG_COUNT); i++)
+			add_burst(bursts + i, offsets, &count, tolerance, &ci);
 
 		// consume used samples
 		cb->purge(consumed);
+
+		// the source ran out and all of it was scanned
+		if(ran_out && !cb->data_available())
+			end = 1;
 	}
 
 	u->stop();
+	if(pool) {
+		delete pool;
+		for(w = 0; w < workers; w++)
+			delete jobs.l[w];
+		delete[] jobs.l;
+		delete[] jobs.b;
+		delete[] found;
+		delete[] win[0];
+		delete[] win[1];
+	}
 	delete l;
 
-	// construct stats
-	sort(offsets, AVG_COUNT);
-	avg_offset = avg(offsets + AVG_THRESHOLD, AVG_COUNT - 2 * AVG_THRESHOLD, &stddev);
-	min = offsets[AVG_THRESHOLD];
-	max = offsets[AVG_COUNT - AVG_THRESHOLD - 1];
+	if(ret)
+		return -1;
+	if(count < AVG_MIN) {
+		fprintf(stderr, "error: only %u bursts before the samples ran out, "
+		   "%u are needed\n", count, AVG_MIN);
+		return -1;
+	}
+
+	// construct stats, offsets are already sorted
+	trim = count / 10;
+	avg_offset = avg(offsets + trim, count - 2 * trim, &stddev);
+	min = offsets[trim];
+	max = offsets[count - trim - 1];
 
 	printf("average\t\t[min, max]\t(range, stddev)\n");
 	display_freq(avg_offset);
@@ -119,6 +329,8 @@ int offset_detect(lime_source *u, float *off) {
 	printf("\t\t[%d, %d]\t(%d, %f)\n", (int)round(min), (int)round(max), (int)round(max - min), stddev);
 	printf("overruns: %u\n", overruns);
 	printf("not found: %u\n", notfound);
+	if(tolerance > 0.0)
+		printf("bursts: %u (+/- %.1fHz)\n", count, ci);
 
 	return 0;
 }
@@ -25,4 +25,4 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-int offset_detect(lime_source *u, float *off);
+int offset_detect(radio_source *u, float *off, float tolerance = 0.0, int estimator = FCCH_EST_FFT, unsigned int workers = 1);
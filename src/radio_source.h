@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * radio_source
+ *
+ *	What the scanning and offset code needs from a receiver.  Samples are
+ *	complex floats at sample_rate(); fill() waits until at least
+ *	num_samples are in get_buffer(), whose single consumer is the caller.
+ *	lime_source implements this for a LimeSDR, file_source for a
+ *	recording.
+ *
+ *	fill() returns -1 on failure.  A source whose samples run out, like a
+ *	recording, returns 1 instead once it has put the last of them in the
+ *	buffer, however few that is.
+ *
+ *	tune() empties the buffer, and every sample fill() provides after it
+ *	was taken at the new frequency once it had settled.  ts, if given, is
+ *	set to the timestamp of the first of those samples, counted in
+ *	samples on the source's own clock.
+ *
+ *	Each source runs the front end kernels over its samples as they land
+ *	in the buffer, so get_stats() has the power of everything received
+ *	since the last flush() or tune() without another pass over the
+ *	samples.
+ */
+
+#pragma once
+
+#include "complex.h"
+#include "circular_buffer.h"
+
+struct capture_stats {
+	unsigned long long	count;	// samples since the last flush() or tune()
+	double			energy;	// sum of |x|^2
+	float			peak;	// largest |x|
+	complex			dc;	// DC offset being removed
+};
+
+class radio_source {
+public:
+	virtual ~radio_source() {};
+
+	virtual int read(complex *buf,
+		unsigned int num_samples,
+		unsigned int *samples_read) = 0;
+
+	virtual int fill(unsigned int num_samples, unsigned int *overrun) = 0;
+	virtual int tune(double freq, unsigned long long *ts = 0) = 0;
+	virtual void start() = 0;
+	virtual void stop() = 0;
+	virtual int flush(unsigned int flush_count = FLUSH_COUNT) = 0;
+	virtual circular_buffer *get_buffer() = 0;
+	virtual void get_stats(capture_stats *s) = 0;
+
+	virtual double sample_rate() = 0;
+	virtual int set_sample_rate(double sample_rate) = 0;
+
+protected:
+	static const unsigned int	FLUSH_COUNT	= 10;
+};
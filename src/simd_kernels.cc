@@ -0,0 +1,686 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "simd_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define D_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define D_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+
+/*
+ * The dot product is summed from the last tap down, newest sample first, in
+ * the order of the original complex filter, so that the scalar kernels
+ * reproduce it bit for bit.
+ */
+static inline void energy_dot_scalar(const float *wr, const float *wi,
+   const float *xr, const float *xi, unsigned int len, float *E, float *yr,
+   float *yi) {
+
+	unsigned int i;
+	float e = 0, r = 0, q = 0;
+
+	for(i = 0; i < len; i++)
+		e += xr[i] * xr[i] + xi[i] * xi[i];
+	for(i = len; i-- > 0; ) {
+		r += wr[i] * xr[i] + wi[i] * xi[i];
+		q += wr[i] * xi[i] - wi[i] * xr[i];
+	}
+	*E = e;
+	*yr = r;
+	*yi = q;
+}
+
+
+static inline void update_scalar(float *wr, float *wi, const float *xr,
+   const float *xi, unsigned int len, float gr, float gi) {
+
+	unsigned int i;
+
+	for(i = 0; i < len; i++) {
+		wr[i] += gr * xr[i] - gi * xi[i];
+		wi[i] += gr * xi[i] + gi * xr[i];
+	}
+}
+
+
+static const lms_kernels scalar_kernels = {
+	"scalar", energy_dot_scalar, update_scalar
+};
+
+
+/*
+ * The front end kernels sum in float lanes and add into the double totals
+ * every FE_BLOCK samples, so long captures do not lose precision.
+ */
+static const unsigned int	FE_BLOCK	= 1024;
+static const unsigned int	FE_STAGE	= 64;
+
+
+/*
+ * The inputs are staged FE_STAGE samples at a time so that, when converting
+ * in place, the compiler cannot move a store ahead of the load of an input
+ * it overwrites.  Output i only overwrites inputs up to i.
+ */
+static void convert_i16_scalar(float *c, const int16_t *u, unsigned int len,
+   const float *dc, double *sum, double *E, float *P) {
+
+	int16_t t[2 * FE_STAGE];
+	unsigned int i, j, n;
+	float r, q, m, sr, si, e, p = *P;
+
+	for(i = 0; i < len; i += n) {
+		n = (len - i < FE_STAGE)? len - i : FE_STAGE;
+		memcpy(t, u + 2 * i, 2 * n * sizeof(int16_t));
+		sr = si = e = 0;
+		for(j = 0; j < n; j++) {
+			r = t[2 * j] - dc[0];
+			q = t[2 * j + 1] - dc[1];
+			c[2 * (i + j)] = r;
+			c[2 * (i + j) + 1] = q;
+			sr += r;
+			si += q;
+			m = r * r + q * q;
+			e += m;
+			if(m > p)
+				p = m;
+		}
+		sum[0] += sr;
+		sum[1] += si;
+		*E += e;
+	}
+	*P = p;
+}
+
+
+static void power_scalar(const float *c, unsigned int len, double *E,
+   float *P) {
+
+	unsigned int i, j, n;
+	float m, e, p = *P;
+
+	for(i = 0; i < len; i += n) {
+		n = (len - i < FE_BLOCK)? len - i : FE_BLOCK;
+		e = 0;
+		for(j = i; j < i + n; j++) {
+			m = c[2 * j] * c[2 * j] + c[2 * j + 1] * c[2 * j + 1];
+			e += m;
+			if(m > p)
+				p = m;
+		}
+		*E += e;
+	}
+	*P = p;
+}
+
+
+static const frontend_kernels scalar_frontend = {
+	"scalar", convert_i16_scalar, power_scalar
+};
+
+
+static inline float max4(const float *t) {
+
+	float a = (t[0] > t[1])? t[0] : t[1], b = (t[2] > t[3])? t[2] : t[3];
+
+	return (a > b)? a : b;
+}
+
+
+#ifdef D_SIMD_X86
+
+__attribute__((target("sse")))
+static inline float hsum_sse(__m128 v) {
+
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+
+__attribute__((target("sse")))
+static void energy_dot_sse(const float *wr, const float *wi, const float *xr,
+   const float *xi, unsigned int len, float *E, float *yr, float *yi) {
+
+	unsigned int i;
+	float sum_e, sum_r, sum_q;
+	__m128 e = _mm_setzero_ps(), r = e, q = e, a, b, c, d;
+
+	for(i = 0; i + 4 <= len; i += 4) {
+		a = _mm_loadu_ps(xr + i);
+		b = _mm_loadu_ps(xi + i);
+		c = _mm_loadu_ps(wr + i);
+		d = _mm_loadu_ps(wi + i);
+		e = _mm_add_ps(e, _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)));
+		r = _mm_add_ps(r, _mm_add_ps(_mm_mul_ps(c, a), _mm_mul_ps(d, b)));
+		q = _mm_add_ps(q, _mm_sub_ps(_mm_mul_ps(c, b), _mm_mul_ps(d, a)));
+	}
+	sum_e = hsum_sse(e);
+	sum_r = hsum_sse(r);
+	sum_q = hsum_sse(q);
+	energy_dot_scalar(wr + i, wi + i, xr + i, xi + i, len - i, E, yr, yi);
+	*E += sum_e;
+	*yr += sum_r;
+	*yi += sum_q;
+}
+
+
+__attribute__((target("sse")))
+static void update_sse(float *wr, float *wi, const float *xr, const float *xi,
+   unsigned int len, float gr, float gi) {
+
+	unsigned int i;
+	__m128 vgr = _mm_set1_ps(gr), vgi = _mm_set1_ps(gi), a, b;
+
+	for(i = 0; i + 4 <= len; i += 4) {
+		a = _mm_loadu_ps(xr + i);
+		b = _mm_loadu_ps(xi + i);
+		_mm_storeu_ps(wr + i, _mm_add_ps(_mm_loadu_ps(wr + i),
+		   _mm_sub_ps(_mm_mul_ps(vgr, a), _mm_mul_ps(vgi, b))));
+		_mm_storeu_ps(wi + i, _mm_add_ps(_mm_loadu_ps(wi + i),
+		   _mm_add_ps(_mm_mul_ps(vgr, b), _mm_mul_ps(vgi, a))));
+	}
+	update_scalar(wr + i, wi + i, xr + i, xi + i, len - i, gr, gi);
+}
+
+
+static const lms_kernels sse_kernels = {
+	"sse", energy_dot_sse, update_sse
+};
+
+
+/*
+ * Four samples at a time.  lo and hi hold two interleaved samples each; their
+ * squares are regrouped into four |c|^2 for the peak.
+ */
+__attribute__((target("sse2")))
+static void convert_i16_sse2(float *c, const int16_t *u, unsigned int len,
+   const float *dc, double *sum, double *E, float *P) {
+
+	unsigned int i = 0, k;
+	float t[4];
+	__m128 d = _mm_setr_ps(dc[0], dc[1], dc[0], dc[1]), p = _mm_set1_ps(*P),
+	   s, e, lo, hi, m;
+	__m128i x;
+
+	while(i + 4 <= len) {
+		s = _mm_setzero_ps();
+		e = s;
+		for(k = 0; (k < FE_BLOCK) && (i + 4 <= len); k += 4, i += 4) {
+			x = _mm_loadu_si128((const __m128i *)(u + 2 * i));
+			lo = _mm_sub_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), d);
+			hi = _mm_sub_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), d);
+			_mm_storeu_ps(c + 2 * i, lo);
+			_mm_storeu_ps(c + 2 * i + 4, hi);
+			s = _mm_add_ps(s, _mm_add_ps(lo, hi));
+			lo = _mm_mul_ps(lo, lo);
+			hi = _mm_mul_ps(hi, hi);
+			m = _mm_add_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)),
+			   _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+			e = _mm_add_ps(e, m);
+			p = _mm_max_ps(p, m);
+		}
+		_mm_storeu_ps(t, s);
+		sum[0] += t[0] + t[2];
+		sum[1] += t[1] + t[3];
+		*E += hsum_sse(e);
+	}
+	_mm_storeu_ps(t, p);
+	*P = max4(t);
+	convert_i16_scalar(c + 2 * i, u + 2 * i, len - i, dc, sum, E, P);
+}
+
+
+__attribute__((target("sse2")))
+static void power_sse2(const float *c, unsigned int len, double *E, float *P) {
+
+	unsigned int i = 0, k;
+	float t[4];
+	__m128 p = _mm_set1_ps(*P), e, lo, hi, m;
+
+	while(i + 4 <= len) {
+		e = _mm_setzero_ps();
+		for(k = 0; (k < FE_BLOCK) && (i + 4 <= len); k += 4, i += 4) {
+			lo = _mm_loadu_ps(c + 2 * i);
+			hi = _mm_loadu_ps(c + 2 * i + 4);
+			lo = _mm_mul_ps(lo, lo);
+			hi = _mm_mul_ps(hi, hi);
+			m = _mm_add_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)),
+			   _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+			e = _mm_add_ps(e, m);
+			p = _mm_max_ps(p, m);
+		}
+		*E += hsum_sse(e);
+	}
+	_mm_storeu_ps(t, p);
+	*P = max4(t);
+	power_scalar(c + 2 * i, len - i, E, P);
+}
+
+
+static const frontend_kernels sse2_frontend = {
+	"sse2", convert_i16_sse2, power_sse2
+};
+
+
+__attribute__((target("avx2,fma")))
+static inline float hsum_avx(__m256 v) {
+
+	return hsum_sse(_mm_add_ps(_mm256_castps256_ps128(v),
+	   _mm256_extractf128_ps(v, 1)));
+}
+
+
+__attribute__((target("avx2,fma")))
+static void energy_dot_avx2(const float *wr, const float *wi, const float *xr,
+   const float *xi, unsigned int len, float *E, float *yr, float *yi) {
+
+	unsigned int i;
+	float sum_e, sum_r, sum_q;
+	__m256 e = _mm256_setzero_ps(), r = e, q = e, a, b, c, d;
+
+	for(i = 0; i + 8 <= len; i += 8) {
+		a = _mm256_loadu_ps(xr + i);
+		b = _mm256_loadu_ps(xi + i);
+		c = _mm256_loadu_ps(wr + i);
+		d = _mm256_loadu_ps(wi + i);
+		e = _mm256_fmadd_ps(a, a, _mm256_fmadd_ps(b, b, e));
+		r = _mm256_fmadd_ps(c, a, _mm256_fmadd_ps(d, b, r));
+		q = _mm256_fmadd_ps(c, b, _mm256_fnmadd_ps(d, a, q));
+	}
+	sum_e = hsum_avx(e);
+	sum_r = hsum_avx(r);
+	sum_q = hsum_avx(q);
+	energy_dot_scalar(wr + i, wi + i, xr + i, xi + i, len - i, E, yr, yi);
+	*E += sum_e;
+	*yr += sum_r;
+	*yi += sum_q;
+}
+
+
+__attribute__((target("avx2,fma")))
+static void update_avx2(float *wr, float *wi, const float *xr, const float *xi,
+   unsigned int len, float gr, float gi) {
+
+	unsigned int i;
+	__m256 vgr = _mm256_set1_ps(gr), vgi = _mm256_set1_ps(gi), a, b;
+
+	for(i = 0; i + 8 <= len; i += 8) {
+		a = _mm256_loadu_ps(xr + i);
+		b = _mm256_loadu_ps(xi + i);
+		_mm256_storeu_ps(wr + i, _mm256_fnmadd_ps(vgi, b,
+		   _mm256_fmadd_ps(vgr, a, _mm256_loadu_ps(wr + i))));
+		_mm256_storeu_ps(wi + i, _mm256_fmadd_ps(vgi, a,
+		   _mm256_fmadd_ps(vgr, b, _mm256_loadu_ps(wi + i))));
+	}
+	update_scalar(wr + i, wi + i, xr + i, xi + i, len - i, gr, gi);
+}
+
+
+static const lms_kernels avx2_kernels = {
+	"avx2", energy_dot_avx2, update_avx2
+};
+
+
+/*
+ * Eight samples at a time.  hadd pairs the squares of lo and hi into |c|^2,
+ * in a different order, which does not matter for the peak.
+ */
+__attribute__((target("avx2,fma")))
+static void convert_i16_avx2(float *c, const int16_t *u, unsigned int len,
+   const float *dc, double *sum, double *E, float *P) {
+
+	unsigned int i = 0, k;
+	float t[8];
+	__m256 d = _mm256_setr_ps(dc[0], dc[1], dc[0], dc[1], dc[0], dc[1], dc[0],
+	   dc[1]), p = _mm256_set1_ps(*P), s, e, lo, hi, a, b;
+
+	while(i + 8 <= len) {
+		s = _mm256_setzero_ps();
+		e = s;
+		for(k = 0; (k < FE_BLOCK) && (i + 8 <= len); k += 8, i += 8) {
+			lo = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			   _mm_loadu_si128((const __m128i *)(u + 2 * i)))), d);
+			hi = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			   _mm_loadu_si128((const __m128i *)(u + 2 * i + 8)))), d);
+			_mm256_storeu_ps(c + 2 * i, lo);
+			_mm256_storeu_ps(c + 2 * i + 8, hi);
+			s = _mm256_add_ps(s, _mm256_add_ps(lo, hi));
+			a = _mm256_mul_ps(lo, lo);
+			b = _mm256_mul_ps(hi, hi);
+			e = _mm256_add_ps(e, _mm256_add_ps(a, b));
+			p = _mm256_max_ps(p, _mm256_hadd_ps(a, b));
+		}
+		_mm256_storeu_ps(t, s);
+		sum[0] += t[0] + t[2] + t[4] + t[6];
+		sum[1] += t[1] + t[3] + t[5] + t[7];
+		*E += hsum_avx(e);
+	}
+	_mm256_storeu_ps(t, p);
+	*P = max4(t);
+	if(max4(t + 4) > *P)
+		*P = max4(t + 4);
+	convert_i16_scalar(c + 2 * i, u + 2 * i, len - i, dc, sum, E, P);
+}
+
+
+__attribute__((target("avx2,fma")))
+static void power_avx2(const float *c, unsigned int len, double *E, float *P) {
+
+	unsigned int i = 0, k;
+	float t[8];
+	__m256 p = _mm256_set1_ps(*P), e, a, b;
+
+	while(i + 8 <= len) {
+		e = _mm256_setzero_ps();
+		for(k = 0; (k < FE_BLOCK) && (i + 8 <= len); k += 8, i += 8) {
+			a = _mm256_loadu_ps(c + 2 * i);
+			b = _mm256_loadu_ps(c + 2 * i + 8);
+			a = _mm256_mul_ps(a, a);
+			b = _mm256_mul_ps(b, b);
+			e = _mm256_add_ps(e, _mm256_add_ps(a, b));
+			p = _mm256_max_ps(p, _mm256_hadd_ps(a, b));
+		}
+		*E += hsum_avx(e);
+	}
+	_mm256_storeu_ps(t, p);
+	*P = max4(t);
+	if(max4(t + 4) > *P)
+		*P = max4(t + 4);
+	power_scalar(c + 2 * i, len - i, E, P);
+}
+
+
+static const frontend_kernels avx2_frontend = {
+	"avx2", convert_i16_avx2, power_avx2
+};
+
+
+__attribute__((target("avx512f")))
+static void energy_dot_avx512(const float *wr, const float *wi,
+   const float *xr, const float *xi, unsigned int len, float *E, float *yr,
+   float *yi) {
+
+	unsigned int i;
+	float sum_e, sum_r, sum_q;
+	__m512 e = _mm512_setzero_ps(), r = e, q = e, a, b, c, d;
+
+	for(i = 0; i + 16 <= len; i += 16) {
+		a = _mm512_loadu_ps(xr + i);
+		b = _mm512_loadu_ps(xi + i);
+		c = _mm512_loadu_ps(wr + i);
+		d = _mm512_loadu_ps(wi + i);
+		e = _mm512_fmadd_ps(a, a, _mm512_fmadd_ps(b, b, e));
+		r = _mm512_fmadd_ps(c, a, _mm512_fmadd_ps(d, b, r));
+		q = _mm512_fmadd_ps(c, b, _mm512_fnmadd_ps(d, a, q));
+	}
+	sum_e = _mm512_reduce_add_ps(e);
+	sum_r = _mm512_reduce_add_ps(r);
+	sum_q = _mm512_reduce_add_ps(q);
+	energy_dot_scalar(wr + i, wi + i, xr + i, xi + i, len - i, E, yr, yi);
+	*E += sum_e;
+	*yr += sum_r;
+	*yi += sum_q;
+}
+
+
+__attribute__((target("avx512f")))
+static void update_avx512(float *wr, float *wi, const float *xr,
+   const float *xi, unsigned int len, float gr, float gi) {
+
+	unsigned int i;
+	__m512 vgr = _mm512_set1_ps(gr), vgi = _mm512_set1_ps(gi), a, b;
+
+	for(i = 0; i + 16 <= len; i += 16) {
+		a = _mm512_loadu_ps(xr + i);
+		b = _mm512_loadu_ps(xi + i);
+		_mm512_storeu_ps(wr + i, _mm512_fnmadd_ps(vgi, b,
+		   _mm512_fmadd_ps(vgr, a, _mm512_loadu_ps(wr + i))));
+		_mm512_storeu_ps(wi + i, _mm512_fmadd_ps(vgi, a,
+		   _mm512_fmadd_ps(vgr, b, _mm512_loadu_ps(wi + i))));
+	}
+	update_scalar(wr + i, wi + i, xr + i, xi + i, len - i, gr, gi);
+}
+
+
+static const lms_kernels avx512_kernels = {
+	"avx512", energy_dot_avx512, update_avx512
+};
+
+#endif /* D_SIMD_X86 */
+
+
+#ifdef D_SIMD_NEON
+
+static inline float hsum_neon(float32x4_t v) {
+
+	float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+
+	return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+
+static void energy_dot_neon(const float *wr, const float *wi, const float *xr,
+   const float *xi, unsigned int len, float *E, float *yr, float *yi) {
+
+	unsigned int i;
+	float sum_e, sum_r, sum_q;
+	float32x4_t e = vdupq_n_f32(0), r = e, q = e, a, b, c, d;
+
+	for(i = 0; i + 4 <= len; i += 4) {
+		a = vld1q_f32(xr + i);
+		b = vld1q_f32(xi + i);
+		c = vld1q_f32(wr + i);
+		d = vld1q_f32(wi + i);
+		e = vmlaq_f32(vmlaq_f32(e, a, a), b, b);
+		r = vmlaq_f32(vmlaq_f32(r, c, a), d, b);
+		q = vmlsq_f32(vmlaq_f32(q, c, b), d, a);
+	}
+	sum_e = hsum_neon(e);
+	sum_r = hsum_neon(r);
+	sum_q = hsum_neon(q);
+	energy_dot_scalar(wr + i, wi + i, xr + i, xi + i, len - i, E, yr, yi);
+	*E += sum_e;
+	*yr += sum_r;
+	*yi += sum_q;
+}
+
+
+static void update_neon(float *wr, float *wi, const float *xr, const float *xi,
+   unsigned int len, float gr, float gi) {
+
+	unsigned int i;
+	float32x4_t vgr = vdupq_n_f32(gr), vgi = vdupq_n_f32(gi), a, b;
+
+	for(i = 0; i + 4 <= len; i += 4) {
+		a = vld1q_f32(xr + i);
+		b = vld1q_f32(xi + i);
+		vst1q_f32(wr + i, vmlsq_f32(vmlaq_f32(vld1q_f32(wr + i), vgr, a), vgi, b));
+		vst1q_f32(wi + i, vmlaq_f32(vmlaq_f32(vld1q_f32(wi + i), vgr, b), vgi, a));
+	}
+	update_scalar(wr + i, wi + i, xr + i, xi + i, len - i, gr, gi);
+}
+
+
+static const lms_kernels neon_kernels = {
+	"neon", energy_dot_neon, update_neon
+};
+
+
+/*
+ * The input is loaded as bytes so that, when converting in place, it may
+ * alias the float output.
+ */
+static void convert_i16_neon(float *c, const int16_t *u, unsigned int len,
+   const float *dc, double *sum, double *E, float *P) {
+
+	unsigned int i = 0, k;
+	float t[4];
+	const float d2[4] = {dc[0], dc[1], dc[0], dc[1]};
+	float32x4_t d = vld1q_f32(d2), p = vdupq_n_f32(*P), s, e, lo, hi, m;
+	float32x4x2_t z;
+	int16x8_t x;
+
+	while(i + 4 <= len) {
+		s = vdupq_n_f32(0);
+		e = s;
+		for(k = 0; (k < FE_BLOCK) && (i + 4 <= len); k += 4, i += 4) {
+			x = vreinterpretq_s16_u8(vld1q_u8((const uint8_t *)(u + 2 * i)));
+			lo = vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), d);
+			hi = vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), d);
+			vst1q_f32(c + 2 * i, lo);
+			vst1q_f32(c + 2 * i + 4, hi);
+			s = vaddq_f32(s, vaddq_f32(lo, hi));
+			z = vuzpq_f32(vmulq_f32(lo, lo), vmulq_f32(hi, hi));
+			m = vaddq_f32(z.val[0], z.val[1]);
+			e = vaddq_f32(e, m);
+			p = vmaxq_f32(p, m);
+		}
+		vst1q_f32(t, s);
+		sum[0] += t[0] + t[2];
+		sum[1] += t[1] + t[3];
+		*E += hsum_neon(e);
+	}
+	vst1q_f32(t, p);
+	*P = max4(t);
+	convert_i16_scalar(c + 2 * i, u + 2 * i, len - i, dc, sum, E, P);
+}
+
+
+static void power_neon(const float *c, unsigned int len, double *E, float *P) {
+
+	unsigned int i = 0, k;
+	float t[4];
+	float32x4_t p = vdupq_n_f32(*P), e, m;
+	float32x4x2_t z;
+
+	while(i + 4 <= len) {
+		e = vdupq_n_f32(0);
+		for(k = 0; (k < FE_BLOCK) && (i + 4 <= len); k += 4, i += 4) {
+			z = vld2q_f32(c + 2 * i);
+			m = vmlaq_f32(vmulq_f32(z.val[0], z.val[0]), z.val[1], z.val[1]);
+			e = vaddq_f32(e, m);
+			p = vmaxq_f32(p, m);
+		}
+		*E += hsum_neon(e);
+	}
+	vst1q_f32(t, p);
+	*P = max4(t);
+	power_scalar(c + 2 * i, len - i, E, P);
+}
+
+
+static const frontend_kernels neon_frontend = {
+	"neon", convert_i16_neon, power_neon
+};
+
+#endif /* D_SIMD_NEON */
+
+
+/*
+ * The widest kernel set that this binary has and this CPU can run.  AVX-512
+ * loses to AVX2 on a 17 tap filter, where it runs one full vector and then a
+ * scalar tail, so it is only used for filters with at least two vectors' work.
+ */
+static const lms_kernels *best_kernels(unsigned int len) {
+
+#ifdef D_SIMD_X86
+	__builtin_cpu_init();
+	if((len >= 32) && __builtin_cpu_supports("avx512f"))
+		return &avx512_kernels;
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return &avx2_kernels;
+	if(__builtin_cpu_supports("sse"))
+		return &sse_kernels;
+#endif
+#ifdef D_SIMD_NEON
+	return &neon_kernels;
+#endif
+	return &scalar_kernels;
+}
+
+
+const lms_kernels *lms_kernels_select(unsigned int len) {
+
+	return best_kernels(len);
+}
+
+
+/*
+ * Store every kernel set that this binary has and this CPU can run in k,
+ * scalar first, and return how many there are (at most k_max).
+ */
+unsigned int lms_kernels_all(const lms_kernels **k, unsigned int k_max) {
+
+	const lms_kernels *all[5];
+	unsigned int n = 0, i;
+
+	all[n++] = &scalar_kernels;
+#ifdef D_SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse"))
+		all[n++] = &sse_kernels;
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		all[n++] = &avx2_kernels;
+	if(__builtin_cpu_supports("avx512f"))
+		all[n++] = &avx512_kernels;
+#endif
+#ifdef D_SIMD_NEON
+	all[n++] = &neon_kernels;
+#endif
+	for(i = 0; (i < n) && (i < k_max); i++)
+		k[i] = all[i];
+
+	return i;
+}
+
+
+/*
+ * The front end streams through memory and gains nothing from AVX-512.
+ */
+const frontend_kernels *frontend_kernels_select() {
+
+#ifdef D_SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return &avx2_frontend;
+	if(__builtin_cpu_supports("sse2"))
+		return &sse2_frontend;
+#endif
+#ifdef D_SIMD_NEON
+	return &neon_frontend;
+#endif
+	return &scalar_frontend;
+}
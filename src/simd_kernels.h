@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simd_kernels
+ *
+ *	Vector versions of the inner loops of the fcch_detector LMS filter.
+ *	The filter taps and the input are kept as separate real and imaginary
+ *	float arrays so that each lane holds one tap.  The weights are stored
+ *	in reverse so that both arrays are walked forwards.
+ *
+ *	energy_dot:	*E = sum |x[i]|^2, *y = sum conj(w[i]) * x[i]
+ *	update:		w[i] += g * x[i]
+ *
+ *	lms_kernels_select() picks the fastest instruction set the CPU supports
+ *	for a filter of len taps.  lms_kernels_all() lists every one it can
+ *	run, for checks and benchmarks.
+ *
+ *	The front end kernels run once over each block of samples as it lands
+ *	in a radio_source's buffer, so that nothing downstream has to walk the
+ *	samples again for their power.  c and dc are interleaved complex.
+ *
+ *	convert_i16:	c[i] = u[i] - dc, *sum += sum c[i],
+ *			*E += sum |c[i]|^2, *P = max(*P, |c[i]|^2)
+ *	power:		*E += sum |c[i]|^2, *P = max(*P, |c[i]|^2)
+ *
+ *	convert_i16 may be run in place with u at or past the upper half of
+ *	the len complex samples at c.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct lms_kernels {
+	const char *name;
+	void (*energy_dot)(const float *wr, const float *wi, const float *xr,
+	   const float *xi, unsigned int len, float *E, float *yr, float *yi);
+	void (*update)(float *wr, float *wi, const float *xr, const float *xi,
+	   unsigned int len, float gr, float gi);
+};
+
+const lms_kernels *lms_kernels_select(unsigned int len);
+unsigned int lms_kernels_all(const lms_kernels **k, unsigned int k_max);
+
+
+struct frontend_kernels {
+	const char *name;
+	void (*convert_i16)(float *c, const int16_t *u, unsigned int len,
+	   const float *dc, double *sum, double *E, float *P);
+	void (*power)(const float *c, unsigned int len, double *E, float *P);
+};
+
+const frontend_kernels *frontend_kernels_select();
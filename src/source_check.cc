@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * source_check
+ *
+ *	Checks file_source on small recordings written to a temporary
+ *	directory.
+ *
+ *	tune	only the recording's center frequency is accepted, or with
+ *		no center frequency, the first one tuned to
+ *	end	at the end of the recording fill() makes the rest readable
+ *		and returns 1
+ *	cs16	a cs16 recording longer than the ring reads back as its
+ *		integers, in order, to the last sample
+ *
+ *	Exits non-zero on any failure, for make check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdint.h>
+#include <string>
+
+#include "file_source.h"
+
+static const double		SAMPLE_RATE	= 1625000.0 / 6.0;
+static const unsigned int	RECORDING_LEN	= 10000;
+static const double		CENTER		= 935.2e6;
+static const double		CHANNEL		= 200e3;
+static const double		IN_BAND		= 100e3;	// < SAMPLE_RATE / 2
+static const unsigned int	CS16_LEN	= (1 << 20) + 12345;	// > the ring
+static const unsigned int	CS16_READ	= 300007;
+
+int g_verbosity = 0;
+
+static char g_dir[] = "/tmp/source_check.XXXXXX";
+
+
+/*
+ * Write len samples of a tone to name in g_dir, as cf32, and the SigMF
+ * metadata for it if center is given.  The full path is left in path.
+ */
+static int write_recording(const char *name, unsigned int len, double center, char *path, size_t path_len) {
+
+	FILE *fp;
+	unsigned int i;
+	float iq[2];
+	std::string meta;
+
+	snprintf(path, path_len, "%s/%s", g_dir, name);
+	if(!(fp = fopen(path, "w"))) {
+		perror(path);
+		return -1;
+	}
+	for(i = 0; i < len; i++) {
+		iq[0] = cosf(0.1f * i);
+		iq[1] = sinf(0.1f * i);
+		fwrite(iq, sizeof(iq), 1, fp);
+	}
+	fclose(fp);
+
+	if(center <= 0.0)
+		return 0;
+
+	meta = path;
+	meta.replace(meta.size() - strlen("data"), strlen("data"), "meta");
+	if(!(fp = fopen(meta.c_str(), "w"))) {
+		perror(meta.c_str());
+		return -1;
+	}
+	fprintf(fp, "{\n\t\"global\": {\n\t\t\"core:datatype\": \"cf32_le\",\n"
+	   "\t\t\"core:sample_rate\": %.1f\n\t},\n\t\"captures\": [\n"
+	   "\t\t{ \"core:sample_start\": 0, \"core:frequency\": %.1f }\n\t]\n}\n",
+	   SAMPLE_RATE, center);
+	fclose(fp);
+
+	return 0;
+}
+
+
+static int expect_tune(file_source *f, double freq, int ok, const char *what) {
+
+	int r = f->tune(freq);
+
+	if(!r != !!ok) {
+		printf("tune     FAIL: %s: tune(%.3fMHz) returned %d\n", what, freq / 1e6, r);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+static int check_tune() {
+
+	char path[BUFSIZ];
+	file_source *f;
+	int bad = 0;
+
+	// the center frequency from the metadata
+	if(write_recording("center.sigmf-data", RECORDING_LEN, CENTER, path, sizeof(path)))
+		return 1;
+	f = new file_source();
+	if(f->open(path)) {
+		printf("tune     FAIL: can't open %s\n", path);
+		delete f;
+		return 1;
+	}
+	bad += expect_tune(f, CENTER, 1, "center");
+	bad += expect_tune(f, CENTER + 1e3, 1, "near the center");
+	bad += expect_tune(f, CENTER + IN_BAND, 0, "off center, in the recorded band");
+	bad += expect_tune(f, CENTER + CHANNEL, 0, "next channel");
+	bad += expect_tune(f, CENTER - CHANNEL, 0, "previous channel");
+	bad += expect_tune(f, CENTER, 1, "back to the center");
+	delete f;
+
+	// no center frequency, so the first tune decides
+	if(write_recording("plain.cf32", RECORDING_LEN, 0.0, path, sizeof(path)))
+		return bad + 1;
+	f = new file_source(SAMPLE_RATE);
+	if(f->open(path)) {
+		printf("tune     FAIL: can't open %s\n", path);
+		delete f;
+		return bad + 1;
+	}
+	bad += expect_tune(f, CENTER, 1, "first tune");
+	bad += expect_tune(f, CENTER, 1, "same frequency");
+	bad += expect_tune(f, CENTER + IN_BAND, 0, "off the first frequency");
+	bad += expect_tune(f, CENTER + CHANNEL, 0, "another frequency");
+	delete f;
+
+	if(!bad)
+		printf("tune     ok: off-center tunes are refused\n");
+
+	return bad;
+}
+
+
+static int check_end() {
+
+	static const unsigned int FIRST = 4000, ASK = 8000;
+
+	char path[BUFSIZ];
+	file_source *f;
+	circular_buffer *cb;
+	unsigned int overrun, avail;
+	int r, bad = 0;
+
+	if(write_recording("short.cf32", RECORDING_LEN, 0.0, path, sizeof(path)))
+		return 1;
+	f = new file_source(SAMPLE_RATE);
+	if(f->open(path) || f->tune(CENTER)) {
+		printf("end      FAIL: can't open %s\n", path);
+		delete f;
+		return 1;
+	}
+	cb = f->get_buffer();
+
+	if((r = f->fill(FIRST, &overrun)) || (cb->data_available() != FIRST)) {
+		printf("end      FAIL: fill(%u) returned %d with %u samples\n", FIRST, r,
+		   cb->data_available());
+		bad++;
+	}
+	cb->purge(FIRST);
+
+	// only RECORDING_LEN - FIRST are left
+	avail = RECORDING_LEN - FIRST;
+	if(((r = f->fill(ASK, &overrun)) != 1) || (cb->data_available() != avail)) {
+		printf("end      FAIL: fill(%u) at the end returned %d with %u samples, "
+		   "expected 1 with %u\n", ASK, r, cb->data_available(), avail);
+		bad++;
+	}
+	if(((r = f->fill(ASK, &overrun)) != 1) || (cb->data_available() != avail)) {
+		printf("end      FAIL: fill(%u) after the end returned %d with %u samples\n",
+		   ASK, r, cb->data_available());
+		bad++;
+	}
+	delete f;
+
+	if(!bad)
+		printf("end      ok: the last %u samples are readable\n", avail);
+
+	return bad;
+}
+
+
+/*
+ * The i16 samples are a ramp that is easy to check on the way out.
+ */
+static inline void cs16_sample(unsigned int i, int16_t *iq) {
+
+	iq[0] = (int16_t)(i % 65536 - 32768);
+	iq[1] = (int16_t)((i * 7) % 4096 - 2048);
+}
+
+
+static int check_cs16() {
+
+	char path[BUFSIZ];
+	FILE *fp;
+	file_source *f;
+	complex *buf;
+	unsigned int i, n, got = 0;
+	int16_t iq[2];
+	int bad = 0;
+
+	snprintf(path, sizeof(path), "%s/ramp.cs16", g_dir);
+	if(!(fp = fopen(path, "w"))) {
+		perror(path);
+		return 1;
+	}
+	for(i = 0; i < CS16_LEN; i++) {
+		cs16_sample(i, iq);
+		fwrite(iq, sizeof(iq), 1, fp);
+	}
+	fclose(fp);
+
+	f = new file_source(SAMPLE_RATE);
+	if(f->open(path) || f->tune(CENTER)) {
+		printf("cs16     FAIL: can't open %s\n", path);
+		delete f;
+		return 1;
+	}
+	if(f->get_buffer()->buf_len() >= CS16_LEN) {
+		printf("cs16     FAIL: the ring holds the whole recording\n");
+		bad++;
+	}
+
+	buf = new complex[CS16_READ];
+	do {
+		if(f->read(buf, CS16_READ, &n)) {
+			printf("cs16     FAIL: read failed after %u samples\n", got);
+			bad++;
+			break;
+		}
+		for(i = 0; (i < n) && !bad; i++) {
+			cs16_sample(got + i, iq);
+			if((buf[i].real() != iq[0]) || (buf[i].imag() != iq[1])) {
+				printf("cs16     FAIL: sample %u is (%g, %g), expected (%d, %d)\n",
+				   got + i, buf[i].real(), buf[i].imag(), iq[0], iq[1]);
+				bad++;
+			}
+		}
+		got += n;
+	} while((n == CS16_READ) && !bad);
+	delete[] buf;
+	delete f;
+
+	if(!bad && (got != CS16_LEN)) {
+		printf("cs16     FAIL: read %u samples of %u\n", got, CS16_LEN);
+		bad++;
+	}
+	if(!bad)
+		printf("cs16     ok: %u samples through the ring\n", got);
+
+	return bad;
+}
+
+
+int main() {
+
+	char cmd[BUFSIZ];
+	int bad = 0;
+
+	if(!mkdtemp(g_dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	bad += check_tune();
+	bad += check_end();
+	bad += check_cs16();
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", g_dir);
+	if(system(cmd))
+		printf("warning: could not remove %s\n", g_dir);
+
+	return bad? 1 : 0;
+}
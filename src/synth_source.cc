@@ -0,0 +1,467 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "synth_source.h"
+
+extern int g_verbosity;
+
+#ifndef MIN
+#define MIN(a, b) ((a)<(b)?(a):(b))
+#endif /* !MIN */
+
+
+/*
+ * splitmix64, used both to seed and to pick the bits
+ */
+static inline unsigned long long mix(unsigned long long x) {
+
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+	return x ^ (x >> 31);
+}
+
+
+synth_source::synth_source(double sample_rate, int bi) {
+
+	unsigned int i;
+	double K, tau;
+
+	m_bi = bi;
+	m_sample_rate = sample_rate;
+	m_freq = 0.0;
+	m_offset = 0.0;
+	m_snr = 20.0;
+	m_mp_delay = 0.0;
+	m_mp_gain = -6.0;
+	m_dc = -INFINITY;
+	m_t0 = 0.0;
+	m_t = 0;
+	m_seed = 1;
+	m_rng = 0;
+	m_overrun_every = 0;
+	m_since = 0;
+	m_overruns = 0;
+	m_n_carriers = 0;
+	m_echo_len = 0;
+	m_echo_pos = 0;
+	m_echo = 0;
+
+	/*
+	 * Gaussian filtered rectangular frequency pulse, BT = 0.3, over
+	 * +/- 2.5 symbols from its center.  It sums to one over the symbols,
+	 * so each symbol turns the phase by pi / 2.
+	 */
+	K = M_PI * 0.3 * sqrt(2.0 / log(2.0));
+	m_pulse = new float[5 * PULSE_RES + 1];
+	for(i = 0; i <= 5 * PULSE_RES; i++) {
+		tau = (double)i / PULSE_RES - 2.5;
+		m_pulse[i] = 0.5 * (erf(K * (tau + 0.5)) - erf(K * (tau - 0.5)));
+	}
+
+	m_scratch = new complex[OVERRUN_DROP];
+	m_cb = new spsc_circular_buffer(CB_LEN, sizeof(complex));
+	m_fe = frontend_kernels_select();
+	m_stats = capture_stats();
+}
+
+
+synth_source::~synth_source() {
+
+	delete m_cb;
+	delete[] m_scratch;
+	delete[] m_echo;
+	delete[] m_pulse;
+}
+
+
+int synth_source::set(const char *key, const char *value) {
+
+	char *end, *v, *tok, *save;
+	double d;
+
+	d = strtod(value, &end);
+	if(!strcmp(key, "arfcn")) {
+		v = strdup(value);
+		for(tok = strtok_r(v, ",", &save); tok; tok = strtok_r(0, ",", &save)) {
+			if(m_n_carriers == MAX_CARRIERS) {
+				fprintf(stderr, "error: too many carriers\n");
+				free(v);
+				return -1;
+			}
+			m_arfcn[m_n_carriers++] = strtol(tok, 0, 0);
+		}
+		free(v);
+		return 0;
+	}
+	if((end == value) || *end) {
+		fprintf(stderr, "error: bad value for %s: ``%s''\n", key, value);
+		return -1;
+	}
+	if(!strcmp(key, "offset"))
+		m_offset = d;
+	else if(!strcmp(key, "snr"))
+		m_snr = d;
+	else if(!strcmp(key, "mpd") && (d >= 0.0))
+		m_mp_delay = d;
+	else if(!strcmp(key, "mpg"))
+		m_mp_gain = d;
+	else if(!strcmp(key, "dc"))
+		m_dc = d;
+	else if(!strcmp(key, "overrun") && (d >= 0.0))
+		m_overrun_every = (unsigned long long)d;
+	else if(!strcmp(key, "seed"))
+		m_seed = (unsigned long long)d;
+	else {
+		fprintf(stderr, "error: bad synthetic source setting: ``%s''\n", key);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int synth_source::open(const char *spec) {
+
+	char *s, *tok, *save, *eq;
+	unsigned int i;
+	int bi;
+	double freq;
+	carrier *c;
+
+	s = strdup(spec? spec : "");
+	for(tok = strtok_r(s, ":", &save); tok; tok = strtok_r(0, ":", &save)) {
+		if(!(eq = strchr(tok, '='))) {
+			fprintf(stderr, "error: bad synthetic source setting: ``%s''\n", tok);
+			free(s);
+			return -1;
+		}
+		*eq = 0;
+		if(set(tok, eq + 1)) {
+			free(s);
+			return -1;
+		}
+	}
+	free(s);
+
+	if(fabs(m_offset) + CARRIER_HALF_BW > m_sample_rate / 2) {
+		fprintf(stderr, "error: offset %.0fHz puts the carrier outside the "
+		   "front end, at most +/- %.0fHz at %.0f samples/s\n", m_offset,
+		   m_sample_rate / 2 - CARRIER_HALF_BW, m_sample_rate);
+		return -1;
+	}
+
+	// with no carriers given, put one wherever we are tuned
+	if(!m_n_carriers) {
+		m_n_carriers = 1;
+		m_arfcn[0] = -1;
+	}
+
+	m_rng = mix(m_seed);
+	for(i = 0; i < m_n_carriers; i++) {
+		c = m_carriers + i;
+		c->freq = 0.0;
+		if(m_arfcn[i] >= 0) {
+			bi = m_bi;
+			if((freq = arfcn_to_freq(m_arfcn[i], &bi)) < 0.0)
+				return -1;
+			c->freq = freq;
+		}
+		c->seed = mix(m_seed + i + 1);
+		c->sym0 = 2.0 + (c->seed >> 11) * (51.0 * 1250.0 / 9007199254740992.0);
+		c->phase = 0.0;
+	}
+	echo_init();
+
+	if(g_verbosity > 0) {
+		fprintf(stderr, "Synthetic source: %u carrier(s), offset %.2fHz, SNR %.1fdB",
+		   m_n_carriers, m_offset, m_snr);
+		if(m_echo_len)
+			fprintf(stderr, ", echo %.1fus at %.1fdB", m_mp_delay, m_mp_gain);
+		if(m_dc > -INFINITY)
+			fprintf(stderr, ", DC %.1fdB", m_dc);
+		if(m_overrun_every)
+			fprintf(stderr, ", overrun every %llu samples", m_overrun_every);
+		fprintf(stderr, "\n");
+	}
+
+	return 0;
+}
+
+
+/*
+ * The echo delay line, in samples at the current rate.
+ */
+void synth_source::echo_init() {
+
+	double g;
+
+	delete[] m_echo;
+	m_echo = 0;
+	m_echo_len = 0;
+	m_echo_pos = 0;
+	if(m_mp_delay <= 0.0)
+		return;
+
+	m_echo_len = (unsigned int)lround(m_mp_delay * 1e-6 * m_sample_rate);
+	if(!m_echo_len)
+		m_echo_len = 1;
+	m_echo = new complex[m_echo_len];
+	for(unsigned int i = 0; i < m_echo_len; i++)
+		m_echo[i] = 0.0;
+
+	// an arbitrary but fixed phase
+	g = pow(10.0, m_mp_gain / 20.0);
+	m_echo_gain = complex(g * cos(1.0), g * sin(1.0));
+}
+
+
+/*
+ * The differentially decoded symbol k, +1 throughout an FCCH burst.
+ */
+float synth_source::symbol(const carrier *c, long long k) {
+
+	long long fn = (k / 1250) % 51, s = k % 1250;
+
+	if((s < 148) && (fn < 50) && !(fn % 10))
+		return 1.0;
+
+	return (mix(c->seed ^ (unsigned long long)k) & 1)? 1.0 : -1.0;
+}
+
+
+/*
+ * A pair of independent unit variance gaussians.
+ */
+void synth_source::noise(double *re, double *im) {
+
+	double u1, u2, r;
+
+	m_rng = mix(m_rng);
+	u1 = ((m_rng >> 11) + 0.5) / 9007199254740992.0;
+	m_rng = mix(m_rng);
+	u2 = (m_rng >> 11) / 9007199254740992.0;
+	r = sqrt(-2.0 * log(u1));
+	*re = r * cos(2.0 * M_PI * u2);
+	*im = r * sin(2.0 * M_PI * u2);
+}
+
+
+void synth_source::generate(complex *buf, unsigned int len) {
+
+	unsigned int i, j, n;
+	long long k, k_last;
+	float a[5];
+	double sps, w, bb, u, f, tau, sigma, dc, nr, ni;
+	complex x, old;
+	carrier *c;
+
+	sps = m_sample_rate / GSM_RATE;
+	for(i = 0; i < len; i++)
+		buf[i] = 0.0;
+
+	for(j = 0; j < m_n_carriers; j++) {
+		c = m_carriers + j;
+
+		// leave out what the front end would filter away
+		bb = ((c->freq > 0.0)? c->freq - m_freq : 0.0) + m_offset;
+		if(fabs(bb) + CARRIER_HALF_BW > m_sample_rate / 2)
+			continue;
+		w = 2.0 * M_PI * bb / m_sample_rate;
+
+		k_last = -1;
+		for(i = 0; i < len; i++) {
+			u = (m_t0 + (double)(m_t + i) / m_sample_rate) * GSM_RATE + c->sym0;
+			k = (long long)u;
+			if(k != k_last) {
+				for(n = 0; n < 5; n++)
+					a[n] = symbol(c, k + n - 2);
+				k_last = k;
+			}
+
+			// instantaneous frequency from the symbols around u
+			f = 0.0;
+			for(n = 0; n < 5; n++) {
+				tau = u - (k + n - 2) - 0.5;
+				f += a[n] * m_pulse[lround((tau + 2.5) * PULSE_RES)];
+			}
+
+			c->phase += w + M_PI / 2.0 * f / sps;
+			buf[i] += complex(cos(c->phase), sin(c->phase));
+		}
+		c->phase = fmod(c->phase, 2.0 * M_PI);
+	}
+
+	sigma = sqrt(sps / pow(10.0, m_snr / 10.0) / 2.0);
+	dc = (m_dc > -INFINITY)? pow(10.0, m_dc / 20.0) : 0.0;
+	for(i = 0; i < len; i++) {
+		x = buf[i];
+		if(m_echo_len) {
+			old = m_echo[m_echo_pos];
+			m_echo[m_echo_pos] = x;
+			m_echo_pos = (m_echo_pos + 1) % m_echo_len;
+			x += m_echo_gain * old;
+		}
+		noise(&nr, &ni);
+		buf[i] = x + complex(sigma * nr + dc, sigma * ni);
+	}
+
+	m_t += len;
+}
+
+
+/*
+ * Generate until num_samples are available, dropping OVERRUN_DROP samples
+ * and counting an overrun every m_overrun_every samples if asked to.
+ */
+int synth_source::fill(unsigned int num_samples, unsigned int *overrun) {
+
+	unsigned int avail, space, len;
+	complex *b;
+
+	if(num_samples > m_cb->buf_len())
+		num_samples = m_cb->buf_len();
+
+	while((avail = m_cb->data_available()) < num_samples) {
+		if(m_overrun_every && (m_since >= m_overrun_every)) {
+			generate(m_scratch, OVERRUN_DROP);
+			m_overruns += 1;
+			m_since = 0;
+		}
+
+		b = (complex *)m_cb->poke(&space);
+		len = MIN(space, num_samples - avail);
+		if(m_overrun_every)
+			len = MIN(len, m_overrun_every - m_since);
+		generate(b, len);
+		m_fe->power((float *)b, len, &m_stats.energy, &m_stats.peak);
+		m_stats.count += len;
+		m_cb->wrote(len);
+		m_since += len;
+	}
+
+	if(overrun)
+		*overrun = m_overruns;
+	m_overruns = 0;
+
+	return 0;
+}
+
+
+int synth_source::read(complex *buf, unsigned int num_samples, unsigned int *samples_read) {
+
+	unsigned int n;
+
+	if(fill(num_samples, 0))
+		return -1;
+
+	n = m_cb->read(buf, num_samples);
+
+	if(samples_read)
+		*samples_read = n;
+
+	return 0;
+}
+
+
+/*
+ * Samples are generated at the new frequency from the next one on.
+ */
+int synth_source::tune(double freq, unsigned long long *ts) {
+
+	m_freq = freq;
+	m_cb->flush();
+	m_stats = capture_stats();
+	if(ts)
+		*ts = m_t;
+
+	return 0;
+}
+
+
+void synth_source::start() {
+
+}
+
+
+void synth_source::stop() {
+
+}
+
+
+int synth_source::flush(unsigned int flush_count) {
+
+	m_cb->flush();
+	fill(flush_count, 0);
+	m_cb->flush();
+	m_stats = capture_stats();
+
+	return 0;
+}
+
+
+circular_buffer *synth_source::get_buffer() {
+
+	return m_cb;
+}
+
+
+void synth_source::get_stats(capture_stats *s) {
+
+	*s = m_stats;
+	s->peak = sqrtf(s->peak);
+}
+
+
+double synth_source::sample_rate() {
+
+	return m_sample_rate;
+}
+
+
+/*
+ * Any rate will do.  Time carries on from where it was at the old rate.
+ */
+int synth_source::set_sample_rate(double sample_rate) {
+
+	if(sample_rate <= 0.0)
+		return -1;
+
+	m_t0 += (double)m_t / m_sample_rate;
+	m_t = 0;
+	m_sample_rate = sample_rate;
+	echo_init();
+	m_cb->flush();
+
+	return 0;
+}
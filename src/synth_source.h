@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * synth_source
+ *
+ *	A radio_source that makes up a GSM downlink, for benchmarks with a
+ *	known answer.  Each carrier is a C0 with GMSK (BT = 0.3) modulated
+ *	random bits and an FCCH burst in timeslot 0 of frames 0, 10, 20, 30
+ *	and 40 of every 51-multiframe, starting at a random point of it.
+ *	Samples are generated as fill() asks for them, so time only goes by as
+ *	fast as they are consumed.
+ *
+ *	open() takes a list of key=value settings separated by ':'
+ *
+ *		arfcn=1,5,17	carriers (default: one on whatever is tuned)
+ *		offset=Hz	frequency error of every carrier (default 0)
+ *		snr=dB		per channel signal to noise ratio (default 20)
+ *		mpd=us		delay of a single echo (default 0, none)
+ *		mpg=dB		gain of the echo (default -6)
+ *		dc=dB		DC spur relative to a carrier (default none)
+ *		overrun=N	drop samples and report an overrun every N
+ *				samples (default 0, never)
+ *		seed=N		random seed (default 1)
+ *
+ *	Carriers that wouldn't fit through the front end at the current
+ *	sample rate and tuning are left out, as a real receiver's filter
+ *	would.  An offset that would leave out even a carrier that is tuned
+ *	to is refused.
+ */
+
+#pragma once
+
+#include "radio_source.h"
+#include "simd_kernels.h"
+#include "arfcn_freq.h"
+
+class synth_source : public radio_source {
+public:
+	synth_source(double sample_rate, int bi = BI_NOT_DEFINED);
+	~synth_source();
+
+	int open(const char *spec);
+	int read(complex *buf,
+		unsigned int num_samples,
+		unsigned int *samples_read);
+
+	int fill(unsigned int num_samples, unsigned int *overrun);
+	int tune(double freq, unsigned long long *ts = 0);
+	void start();
+	void stop();
+	int flush(unsigned int flush_count = FLUSH_COUNT);
+	circular_buffer *get_buffer();
+	void get_stats(capture_stats *s);
+
+	double sample_rate();
+	int set_sample_rate(double sample_rate);
+
+private:
+	struct carrier {
+		double			freq,	// 0 follows the tuning
+					sym0,	// symbol at time 0
+					phase;
+		unsigned long long	seed;
+	};
+
+	int set(const char *key, const char *value);
+	void echo_init();
+	float symbol(const carrier *c, long long k);
+	void generate(complex *buf, unsigned int len);
+	void noise(double *re, double *im);
+
+	static constexpr double		GSM_RATE	= 1625000.0 / 6.0;
+	static const unsigned int	MAX_CARRIERS	= 128;
+	static constexpr double		CARRIER_HALF_BW	= 100e3;
+	static const unsigned int	PULSE_RES	= 64;	// per symbol
+	static const unsigned int	OVERRUN_DROP	= 4096;
+	static const unsigned int	CB_LEN		= (1 << 20);
+
+	int			m_bi;
+	double			m_sample_rate,
+				m_freq,
+				m_offset,
+				m_snr,
+				m_mp_delay,
+				m_mp_gain,
+				m_dc,
+				m_t0;
+	unsigned long long	m_t,
+				m_seed,
+				m_rng,
+				m_overrun_every,
+				m_since;
+	unsigned int		m_overruns,
+				m_n_carriers,
+				m_echo_len,
+				m_echo_pos;
+	int			m_arfcn[MAX_CARRIERS];
+	carrier			m_carriers[MAX_CARRIERS];
+	float			*m_pulse;
+	complex			m_echo_gain,
+				*m_echo,
+				*m_scratch;
+	circular_buffer		*m_cb;
+	const frontend_kernels	*m_fe;
+	capture_stats		m_stats;	// peak squared
+};
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <stdexcept>
+#include <string>
+#include "worker_pool.h"
+
+struct worker_arg {
+	worker_pool	*pool;
+	unsigned int	worker;
+};
+
+
+worker_pool::worker_pool(unsigned int n_workers, job_fn fn, void *ctx) {
+
+	unsigned int i;
+	int err;
+	worker_arg *arg;
+
+	if(!n_workers || !fn)
+		throw std::runtime_error("worker_pool: bad parameters");
+
+	m_fn = fn;
+	m_ctx = ctx;
+	m_workers = n_workers;
+	m_jobs = m_next = m_done = 0;
+	m_generation = 0;
+	m_shutdown = 0;
+
+	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_start, 0);
+	pthread_cond_init(&m_finish, 0);
+
+	m_threads = new pthread_t[m_workers];
+	for(i = 0; i < m_workers; i++) {
+		arg = new worker_arg;
+		arg->pool = this;
+		arg->worker = i;
+		if((err = pthread_create(&m_threads[i], 0, thread_main, arg))) {
+			// don't leave the threads already started behind
+			delete arg;
+			m_workers = i;
+			shutdown();
+			throw std::runtime_error(std::string("worker_pool: pthread_create: ") +
+			   strerror(err));
+		}
+	}
+}
+
+
+worker_pool::~worker_pool() {
+
+	shutdown();
+}
+
+
+/*
+ * Stop and join the m_workers threads that were started, and free what the
+ * constructor set up.
+ */
+void worker_pool::shutdown() {
+
+	unsigned int i;
+
+	pthread_mutex_lock(&m_mutex);
+	m_shutdown = 1;
+	pthread_cond_broadcast(&m_start);
+	pthread_mutex_unlock(&m_mutex);
+
+	for(i = 0; i < m_workers; i++)
+		pthread_join(m_threads[i], 0);
+	delete[] m_threads;
+
+	pthread_cond_destroy(&m_finish);
+	pthread_cond_destroy(&m_start);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+unsigned int worker_pool::workers() {
+
+	return m_workers;
+}
+
+
+/*
+ * Number of online processors, at least one.
+ */
+unsigned int worker_pool::cpu_count() {
+
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0)? (unsigned int)n : 1;
+}
+
+
+void worker_pool::run(unsigned int n_jobs) {
+
+	start(n_jobs);
+	wait();
+}
+
+
+/*
+ * Hand out n_jobs jobs and return without waiting for them.  wait() must be
+ * called before the next start() or run().
+ */
+void worker_pool::start(unsigned int n_jobs) {
+
+	pthread_mutex_lock(&m_mutex);
+	m_jobs = n_jobs;
+	m_next = 0;
+	m_done = 0;
+	if(n_jobs) {
+		m_generation += 1;
+		pthread_cond_broadcast(&m_start);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+void worker_pool::wait() {
+
+	pthread_mutex_lock(&m_mutex);
+	while(m_done < m_jobs)
+		pthread_cond_wait(&m_finish, &m_mutex);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+void *worker_pool::thread_main(void *arg) {
+
+	worker_arg *w = (worker_arg *)arg;
+
+	w->pool->work(w->worker);
+	delete w;
+
+	return 0;
+}
+
+
+void worker_pool::work(unsigned int worker) {
+
+	unsigned int generation = 0, job;
+
+	pthread_mutex_lock(&m_mutex);
+	while(!m_shutdown) {
+		if((generation == m_generation) || (m_next >= m_jobs)) {
+			generation = m_generation;
+			pthread_cond_wait(&m_start, &m_mutex);
+			continue;
+		}
+
+		job = m_next++;
+		pthread_mutex_unlock(&m_mutex);
+
+		m_fn(m_ctx, worker, job);
+
+		pthread_mutex_lock(&m_mutex);
+		if(++m_done == m_jobs)
+			pthread_cond_signal(&m_finish);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026, the kalibrate-lms contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     *  Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *     *  Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * worker_pool
+ *
+ *	A fixed set of threads that run a batch of independent jobs.  run()
+ *	hands out job numbers 0 .. n_jobs - 1 to the workers and returns once
+ *	all of them have finished; start() and wait() do the same in two
+ *	steps so the caller can work in the meantime.  Each worker passes its
+ *	own index to fn so that it can use per-worker state (e.g., its own
+ *	fcch_detector).
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+class worker_pool {
+public:
+	typedef void (*job_fn)(void *ctx, unsigned int worker, unsigned int job);
+
+	worker_pool(unsigned int n_workers, job_fn fn, void *ctx);
+	~worker_pool();
+
+	void run(unsigned int n_jobs);
+	void start(unsigned int n_jobs);
+	void wait();
+	unsigned int workers();
+
+	static unsigned int cpu_count();
+
+private:
+	static void *thread_main(void *arg);
+	void shutdown();
+	void work(unsigned int worker);
+
+	job_fn		m_fn;
+	void		*m_ctx;
+	unsigned int	m_workers,
+			m_jobs,
+			m_next,
+			m_done,
+			m_generation,
+			m_shutdown;
+	pthread_t	*m_threads;
+
+	pthread_mutex_t	m_mutex;
+	pthread_cond_t	m_start,
+			m_finish;
+};